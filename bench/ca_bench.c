@@ -0,0 +1,635 @@
+/*
+ *
+ * Benchmark driver for the libca backends.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ *
+ * ca_bench: runs every selected backend over a matrix of grid sizes and
+ * thread counts and reports cell updates per second. Each configuration
+ * runs -w untimed repetitions (warm-up: page faults, thread start-up, caches)
+ * and -i timed ones. Every repetition creates a fresh engine filled from the
+ * same seed, so all of them step the same grid from a cold HashLife cache,
+ * and steps it <timesteps> generations. The timing of a repetition covers
+ * the steps and the final ca_engine_sync(); creating the engine is timed on
+ * its own, as init.
+ *
+ * ca_bench_mpi: the same driver under mpirun, built against libca_mpi_omp.
+ * Its default backends are serial (rank 0 alone, the baseline) and mpi
+ * (all ranks, -n setting the OpenMP threads per rank).
+ *
+ * Per configuration it reports the median, min, mean and standard deviation
+ * of the repetitions, cell updates per second at the median, and against
+ * the backend's serial counterpart at the same size (serial for the
+ * synchronous backends, rand_ind and rand_order for their threaded
+ * versions) the speedup and the parallel efficiency, speedup / (threads *
+ * procs). rand_ind and rand_ind_pthreads update one cell per timestep, so
+ * they are stepped rows*cols timesteps per generation: every backend does
+ * the same number of cell updates.
+ *
+ * The table goes to stdout once every configuration has run, so that each
+ * row has its baseline; -O file.json or -O file.csv writes the results in
+ * machine readable form, with the host, CPU and libca version, to compare
+ * runs across versions and machines.
+ *
+ * Options:
+ *   -b backends   comma separated (default serial,pthreads,omp,rand_ind,
+ *                 rand_ind_pthreads,rand_order,rand_order_pthreads)
+ *   -s sizes      comma separated square grid sizes (default 254,510,1022,2046)
+ *   -n threads    comma separated thread counts for the threaded backends
+ *                 (default 1, 2, 4, ... up to the online CPUs)
+ *   -t timesteps  generations per repetition (default 100)
+ *   -w warmup     untimed repetitions (default 1)
+ *   -i reps       timed repetitions (default 5)
+ *   -k kernel, -r rule, -P affinity, --seed n: as in ca_serial
+ *   -c allgather|halo, -d 1d|2d, -o: mpi backend modes, as in ca_mpi
+ *   -O file       results as JSON (.json) or CSV (.csv)
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#ifdef CA_BENCH_MPI
+#include <mpi.h>
+#include "ca_mpi.h"
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "ca.h"
+
+#ifndef CA_BENCH_VERSION
+#define CA_BENCH_VERSION "unknown"
+#endif
+
+#define MAX_LIST 64
+
+typedef struct {
+    const char *name;
+    bool threaded;          /* runs with each -n thread count */
+    bool one_cell;          /* updates one cell per timestep */
+    const char *baseline;   /* serial counterpart for speedup/efficiency */
+} bench_backend_t;
+
+static const bench_backend_t backends[] = {
+    {"serial",              false, false, "serial"},
+    {"pthreads",            true,  false, "serial"},
+    {"omp",                 true,  false, "serial"},
+    {"hashlife",            false, false, "serial"},
+    {"mpi",                 true,  false, "serial"},
+    {"rand_ind",            false, true,  "rand_ind"},
+    {"rand_ind_pthreads",   true,  true,  "rand_ind"},
+    {"rand_order",          false, false, "rand_order"},
+    {"rand_order_pthreads", true,  false, "rand_order"},
+};
+
+typedef struct {
+    const bench_backend_t *backend;
+    int size;
+    int threads;
+    int procs;
+    double init;            /* median ca_engine_create() time */
+    double median;
+    double min;
+    double mean;
+    double stddev;
+    double updates;         /* cell updates per second at the median */
+    double speedup;         /* 0 = no baseline measured */
+    double efficiency;
+    double *times;
+} result_t;
+
+int my_rank = 0;
+int nprocs = 1;
+
+int timesteps = 100;
+int warmup = 1;
+int reps = 5;
+
+result_t *results;
+int nresults = 0;
+
+double now();
+int parse_list(const char *s, int *out);
+const bench_backend_t *find_backend(const char *name);
+int compare_doubles(const void*, const void*);
+bool run_config(const bench_backend_t*, int, int, const ca_config_t*, result_t*);
+void set_baselines();
+void print_table();
+void write_json(FILE*, const ca_config_t*);
+void write_csv(FILE*);
+void usage();
+
+
+double now() {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+
+}
+
+
+/*
+ * Parse a comma separated list of positive integers. Returns its length, or
+ * -1 if malformed.
+ */
+int parse_list(const char *s, int *out) {
+
+    int n = 0;
+    while (*s != '\0') {
+        char *end;
+        long v = strtol(s, &end, 10);
+        if (end == s || v < 1 || n == MAX_LIST || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        out[n++] = (int)v;
+        s = *end == ',' ? end + 1 : end;
+    }
+    return n;
+
+}
+
+
+const bench_backend_t *find_backend(const char *name) {
+
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (strcmp(backends[i].name, name) == 0) {
+            return &backends[i];
+        }
+    }
+    return NULL;
+
+}
+
+
+int compare_doubles(const void *a, const void *b) {
+
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+
+}
+
+
+/*
+ * Benchmark one backend at one size and thread count. Returns false if the
+ * engine can't be created for it (the reason is printed); r is then unset.
+ */
+bool run_config(const bench_backend_t *b, int size, int threads, const ca_config_t *base,
+                result_t *r) {
+
+    ca_config_t config = *base;
+    config.threads = threads;
+    config.randomize = true;
+    bool all_ranks = strcmp(b->name, "mpi") == 0;
+#ifdef _OPENMP
+    if (all_ranks) {
+        omp_set_num_threads(threads);
+    }
+#endif
+
+    // the other backends run on rank 0 while the other ranks wait
+    bool active = all_ranks || my_rank == 0;
+    ca_grid_t *grid = NULL;
+    double *times = (double*) calloc(reps, sizeof(double));
+    double *inits = (double*) calloc(warmup + reps, sizeof(double));
+    if (active) {
+        grid = (my_rank == 0) ? ca_grid_alloc(size, size) : ca_grid_shape(size, size);
+    }
+
+    for (int i = -warmup; i < reps; i++) {
+        // a fresh engine from the same seed, outside the timed steps
+        ca_engine_t *engine = NULL;
+        if (active) {
+            double start = now();
+            engine = ca_engine_create(b->name, grid, &config);
+            inits[warmup + i] = now() - start;
+        }
+        int ok = !active || engine != NULL;
+#ifdef CA_BENCH_MPI
+        MPI_Bcast(&ok, 1, MPI_INT, 0, MPI_COMM_WORLD);
+#endif
+        if (!ok) {
+            if (grid != NULL) {
+                ca_grid_free(grid);
+            }
+            free(times);
+            free(inits);
+            return false;
+        }
+
+#ifdef CA_BENCH_MPI
+        MPI_Barrier(MPI_COMM_WORLD);
+#endif
+        double start = now();
+        if (active) {
+            // a generation of the one cell backends is one sweep's worth of updates
+            for (int t = 0; t < (b->one_cell ? timesteps : 1); t++) {
+                ca_engine_step(engine, b->one_cell ? size * size : timesteps);
+            }
+            ca_engine_sync(engine);
+        }
+#ifdef CA_BENCH_MPI
+        if (all_ranks) {
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+#endif
+        if (i >= 0) {
+            times[i] = now() - start;
+        }
+        if (active) {
+            ca_engine_free(engine);
+        }
+    }
+    if (active) {
+        ca_grid_free(grid);
+    }
+    qsort(inits, warmup + reps, sizeof(double), compare_doubles);
+    double init = inits[(warmup + reps) / 2];
+    free(inits);
+
+    memset(r, 0, sizeof(result_t));
+    r->backend = b;
+    r->size = size;
+    r->threads = b->threaded ? threads : 1;
+    r->procs = all_ranks ? nprocs : 1;
+    r->init = init;
+    r->times = times;
+
+    double *sorted = (double*) malloc(reps * sizeof(double));
+    memcpy(sorted, times, reps * sizeof(double));
+    qsort(sorted, reps, sizeof(double), compare_doubles);
+    r->median = reps % 2 ? sorted[reps/2] : (sorted[reps/2 - 1] + sorted[reps/2]) / 2;
+    r->min = sorted[0];
+    for (int i = 0; i < reps; i++) {
+        r->mean += times[i] / reps;
+    }
+    for (int i = 0; i < reps; i++) {
+        r->stddev += (times[i] - r->mean) * (times[i] - r->mean);
+    }
+    r->stddev = reps > 1 ? sqrt(r->stddev / (reps - 1)) : 0.0;
+    r->updates = r->median > 0.0 ? (double)size * size * timesteps / r->median : 0.0;
+    free(sorted);
+    return true;
+
+}
+
+
+/*
+ * Speedup and efficiency of every result against its baseline backend at
+ * the same size, where that was measured.
+ */
+void set_baselines() {
+
+    for (int i = 0; i < nresults; i++) {
+        result_t *r = &results[i];
+        for (int j = 0; j < nresults; j++) {
+            const result_t *base = &results[j];
+            if (strcmp(base->backend->name, r->backend->baseline) == 0 &&
+                    base->size == r->size && r->median > 0.0) {
+                r->speedup = base->median / r->median;
+                r->efficiency = r->speedup / (r->threads * r->procs);
+                break;
+            }
+        }
+    }
+
+}
+
+
+void print_table() {
+
+    printf("%-20s %11s %7s %5s %10s %10s %10s %10s %12s %8s %10s\n", "backend", "size",
+           "threads", "procs", "init", "median", "min", "stddev", "updates/s", "speedup",
+           "efficiency");
+    for (int i = 0; i < nresults; i++) {
+        const result_t *r = &results[i];
+        char size[32];
+        snprintf(size, sizeof(size), "%dx%d", r->size, r->size);
+        printf("%-20s %11s %7d %5d %9.3gs %9.3gs %9.3gs %9.3gs %12.4e ",
+               r->backend->name, size, r->threads, r->procs, r->init, r->median, r->min,
+               r->stddev, r->updates);
+        if (r->speedup > 0.0) {
+            printf("%8.2f %9.1f%%\n", r->speedup, 100.0 * r->efficiency);
+        } else {
+            printf("%8s %10s\n", "-", "-");
+        }
+    }
+
+}
+
+
+/*
+ * First "model name" of /proc/cpuinfo, or "unknown".
+ */
+static void cpu_model(char *buf, size_t len) {
+
+    snprintf(buf, len, "unknown");
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (f == NULL) {
+        return;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *colon = strchr(line, ':');
+        if (strncmp(line, "model name", 10) == 0 && colon != NULL) {
+            colon += 2;
+            colon[strcspn(colon, "\n")] = '\0';
+            snprintf(buf, len, "%s", colon);
+            break;
+        }
+    }
+    fclose(f);
+
+}
+
+
+/* JSON number, null for a missing baseline */
+static void json_ratio(FILE *f, const char *key, double v, const char *sep) {
+
+    if (v > 0.0) {
+        fprintf(f, "\"%s\": %.6g%s", key, v, sep);
+    } else {
+        fprintf(f, "\"%s\": null%s", key, sep);
+    }
+
+}
+
+
+void write_json(FILE *f, const ca_config_t *config) {
+
+    char host[256] = "unknown", cpu[256];
+    gethostname(host, sizeof(host) - 1);
+    cpu_model(cpu, sizeof(cpu));
+    char date[32];
+    time_t t = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"version\": \"%s\",\n", CA_BENCH_VERSION);
+    fprintf(f, "  \"date\": \"%s\",\n", date);
+    fprintf(f, "  \"host\": \"%s\",\n", host);
+    fprintf(f, "  \"cpu\": \"%s\",\n", cpu);
+    fprintf(f, "  \"online_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(f, "  \"procs\": %d,\n", nprocs);
+    fprintf(f, "  \"kernel\": \"%s\",\n", config->kernel);
+    fprintf(f, "  \"rule\": \"%s\",\n", config->rule != NULL ? config->rule : "B3/S23");
+    fprintf(f, "  \"seed\": %llu,\n", (unsigned long long)config->seed);
+    fprintf(f, "  \"timesteps\": %d,\n", timesteps);
+    fprintf(f, "  \"warmup\": %d,\n", warmup);
+    fprintf(f, "  \"repetitions\": %d,\n", reps);
+    fprintf(f, "  \"results\": [\n");
+    for (int i = 0; i < nresults; i++) {
+        const result_t *r = &results[i];
+        fprintf(f, "    {\"backend\": \"%s\", \"rows\": %d, \"cols\": %d, \"threads\": %d, "
+                "\"procs\": %d, \"init_s\": %.6g, \"median_s\": %.6g, \"min_s\": %.6g, "
+                "\"mean_s\": %.6g, \"stddev_s\": %.6g, \"updates_per_s\": %.6g, ",
+                r->backend->name, r->size, r->size, r->threads, r->procs, r->init,
+                r->median, r->min, r->mean, r->stddev, r->updates);
+        json_ratio(f, "speedup", r->speedup, ", ");
+        json_ratio(f, "efficiency", r->efficiency, ", ");
+        fprintf(f, "\"times_s\": [");
+        for (int k = 0; k < reps; k++) {
+            fprintf(f, "%.6g%s", r->times[k], k + 1 < reps ? ", " : "");
+        }
+        fprintf(f, "]}%s\n", i + 1 < nresults ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+
+}
+
+
+void write_csv(FILE *f) {
+
+    fprintf(f, "version,backend,rows,cols,threads,procs,timesteps,repetitions,init_s,median_s,"
+               "min_s,mean_s,stddev_s,updates_per_s,speedup,efficiency\n");
+    for (int i = 0; i < nresults; i++) {
+        const result_t *r = &results[i];
+        fprintf(f, "%s,%s,%d,%d,%d,%d,%d,%d,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,",
+                CA_BENCH_VERSION, r->backend->name, r->size, r->size, r->threads, r->procs,
+                timesteps, reps, r->init, r->median, r->min, r->mean, r->stddev, r->updates);
+        if (r->speedup > 0.0) {
+            fprintf(f, "%.6g,%.6g\n", r->speedup, r->efficiency);
+        } else {
+            fprintf(f, ",\n");
+        }
+    }
+
+}
+
+
+/*
+ * Print usage and exit.
+ */
+void usage() {
+
+    if (my_rank == 0) {
+        printf("Usage: ./ca_bench [-b backends] [-s sizes] [-n threads] [-t timesteps] [-w warmup] [-i reps] [-k kernel] [-r rule] [-P compact|scatter|cpus] [--seed n] [-c allgather|halo] [-d 1d|2d] [-o] [-O results.json|results.csv]\n");
+    }
+#ifdef CA_BENCH_MPI
+    MPI_Finalize();
+#endif
+    exit(EXIT_FAILURE);
+
+}
+
+
+/*
+ * Main routine.
+ */
+int main(int argc, char* argv[])
+{
+#ifdef CA_BENCH_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    ca_mpi_register();
+    const char *backend_list = "serial,mpi";
+#else
+    const char *backend_list = "serial,pthreads,omp,rand_ind,rand_ind_pthreads,rand_order,rand_order_pthreads";
+#endif
+
+    ca_config_t config;
+    ca_config_default(&config);
+    int sizes[MAX_LIST] = {254, 510, 1022, 2046}, nsizes = 4;
+    int threads[MAX_LIST], nthreads = 0;
+    const char *output = NULL;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int t = 1; t <= cpus && nthreads < MAX_LIST; t *= 2) {
+        threads[nthreads++] = t;
+    }
+
+    static const struct option long_options[] = {
+        {"seed", required_argument, NULL, 'S'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "b:s:n:t:w:i:k:r:P:c:d:oO:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'b':
+            backend_list = optarg;
+            break;
+        case 's':
+            if ((nsizes = parse_list(optarg, sizes)) < 0) {
+                printf("ERROR: sizes must be a list of positive integers, e.g. 510,1022\n");
+                usage();
+            }
+            break;
+        case 'n':
+            if ((nthreads = parse_list(optarg, threads)) < 0) {
+                printf("ERROR: threads must be a list of positive integers, e.g. 1,2,4\n");
+                usage();
+            }
+            break;
+        case 't':
+            timesteps = atoi(optarg);
+            if (timesteps < 1) {
+                printf("ERROR: timesteps must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            if (warmup < 0) {
+                printf("ERROR: warm-up repetitions can't be negative\n");
+                usage();
+            }
+            break;
+        case 'i':
+            reps = atoi(optarg);
+            if (reps < 1) {
+                printf("ERROR: repetitions must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'k':
+            config.kernel = optarg;
+            break;
+        case 'r':
+            config.rule = optarg;
+            break;
+        case 'P':
+            config.affinity = optarg;
+            break;
+        case 'S': {
+            char *end;
+            config.seed = strtoull(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0') {
+                printf("ERROR: seed must be a non-negative integer\n");
+                usage();
+            }
+            break;
+        }
+        case 'c':
+            if (strcmp(optarg, "allgather") == 0) {
+                config.halo = false;
+            } else if (strcmp(optarg, "halo") == 0) {
+                config.halo = true;
+            } else {
+                printf("ERROR: unknown communication mode '%s'\n", optarg);
+                usage();
+            }
+            break;
+        case 'd':
+            if (strcmp(optarg, "1d") == 0) {
+                config.decomp_2d = false;
+            } else if (strcmp(optarg, "2d") == 0) {
+                config.decomp_2d = true;
+                config.halo = true;
+            } else {
+                printf("ERROR: unknown decomposition '%s'\n", optarg);
+                usage();
+            }
+            break;
+        case 'o':
+            config.overlap = true;
+            config.halo = true;
+            break;
+        case 'O':
+            output = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc != optind) {
+        usage();
+    }
+    const char *ext = output != NULL ? strrchr(output, '.') : NULL;
+    bool csv = ext != NULL && strcmp(ext, ".csv") == 0;
+    if (output != NULL && !csv && (ext == NULL || strcmp(ext, ".json") != 0)) {
+        printf("ERROR: results are written as .json or .csv, not '%s'\n", output);
+        usage();
+    }
+
+    // every rank runs the same configurations with rank 0's seed
+#ifdef CA_BENCH_MPI
+    MPI_Bcast(&config.seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+#endif
+
+    const bench_backend_t *selected[MAX_LIST];
+    int nselected = 0;
+    char *list = strdup(backend_list), *save;
+    for (char *name = strtok_r(list, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+        const bench_backend_t *b = find_backend(name);
+        if (b == NULL || nselected == MAX_LIST) {
+            printf("ERROR: unknown backend '%s'\n", name);
+            usage();
+        }
+        selected[nselected++] = b;
+    }
+    free(list);
+
+    results = (result_t*) malloc((size_t)nselected * nsizes * nthreads * sizeof(result_t));
+    for (int s = 0; s < nsizes; s++) {
+        for (int i = 0; i < nselected; i++) {
+            const bench_backend_t *b = selected[i];
+            for (int t = 0; t < (b->threaded ? nthreads : 1); t++) {
+                result_t *r = &results[nresults];
+                if (!run_config(b, sizes[s], b->threaded ? threads[t] : 1, &config, r)) {
+                    continue;
+                }
+                nresults++;
+            }
+        }
+    }
+    // baselines may come after the backends measured against them
+    set_baselines();
+    if (my_rank == 0) {
+        print_table();
+    }
+
+    int err = 0;
+    if (my_rank == 0 && output != NULL) {
+        FILE *f = fopen(output, "w");
+        if (f == NULL) {
+            printf("ERROR: could not create '%s'\n", output);
+            err = 1;
+        } else {
+            if (csv) {
+                write_csv(f);
+            } else {
+                write_json(f, &config);
+            }
+            err = fclose(f) != 0;
+        }
+    }
+
+    for (int i = 0; i < nresults; i++) {
+        free(results[i].times);
+    }
+    free(results);
+#ifdef CA_BENCH_MPI
+    MPI_Finalize();
+#endif
+    return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
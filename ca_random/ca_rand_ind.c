@@ -10,129 +10,123 @@
  * Authors: Paul Bailey, Jenna Horrall, Callan Hand
  *
  * ca_rand_ind: uses a the random independent order scheme to randomize the matrix.
- * one cell is chosen to be updated at random each time step. 
+ * one cell is chosen to be updated at random each time step. Runs the rand_ind
+ * backend of libca.
+ *
+ * Threads (-n threads): runs the rand_ind_pthreads backend instead. The
+ * updates run in small batches whose cells are drawn over the whole grid;
+ * within a batch the rows are cut into strips of 8 and even strips and odd
+ * strips take turns, so the threads never update neighboring cells at the
+ * same time. Each cell is still updated with probability 1/(rows*cols) per
+ * timestep, and the result is the same for any thread count with the same
+ * seed.
+ *
+ * The updates per second of the stepping alone (without initialization) are
+ * reported after the timing line, to compare the two.
+ *
+ * Kernels (-k): int (default) or lut, a 512 entry table indexed by the
+ * packed 3x3 neighborhood.
+ *
+ * Rules (-r): B3/S23 (Game of Life, default), any other Life-like rule
+ * such as B36/S23, or a Generations rule such as B2/S/3. Rules other than
+ * B3/S23 run with the int kernel.
+ *
+ * Seed (--seed n): the initial cellspace and the update order depend only
+ * on the seed, whatever the thread count. Without --seed it is taken from
+ * the clock; the timing line reports it so a run can be repeated.
+ *
+ * Checkpoints (--checkpoint file): the state of the run is saved to file at
+ * the end and, with --checkpoint-every n, every n timesteps. --restart file
+ * continues a saved run up to <timesteps> in total, with the seed and rule
+ * it was started with; rows and cols have to match.
+ *
+ * Frames (--frames file): the cellspace is written to file every 10
+ * timesteps, or every n with --frames-every n, as a sequence of binary
+ * netpbm images: file.pbm one bit per cell, file.pgm one byte per cell
+ * (needed for Generations rules). A background thread encodes and writes
+ * them while the run goes on. With -n frames cut the run into steps like
+ * checkpoints do.
+ *
+ * Patterns (--pattern file): start from an RLE (.rle) or plaintext (.cells)
+ * Life pattern instead of a random cellspace, centered or with its top left
+ * cell at --pattern-at row,col. The rest of the cellspace starts dead; the
+ * rule comes from the RLE header unless -r is given.
  *
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <time.h>
 #include <stdbool.h>
+#include <getopt.h>
 #include "timer.h"
+#include "ca.h"
 
 int ROWS;
 int COLS;
 
-int MAX_ROWS;
-int MAX_COLS;
-
-bool debug_mode = false;
-
-/*global matrix*/
-int *cells;
 int timesteps;
 
-void initialize();
-bool transition(int, int);
-void print_cellspace(int*, int);
-void ca_routine();
+const char *checkpoint_path = NULL;
+int checkpoint_every = 0;
+const char *frames_path = NULL;
+int frames_every = 10;
+ca_frames_t *frames = NULL;
 
+void ca_routine(ca_engine_t*, ca_grid_t*);
+void usage();
 
-/*
- * Randomly generate a matrix of MAX_ROWS x MAX_COLS.
- * Each cell has two possible states: 0 (inactive) or 1 (active).
- */
-void initialize() {
-
-    srand(time(0));
-    for (int x = 0; x < MAX_ROWS; x++) {
-        for (int y = 0; y < MAX_COLS; y++) {
-               // set to outer layer to all 1's to account for border cell transitions
-               if (x == ROWS+1 || x == 0 || y == 0 || y == COLS+1) {
-                   *(cells + x*(COLS+2) + y) = 1;
-               } else {
-                   *(cells + x*(COLS+2) + y) = (rand() % (11 - 10 + 1) + 10) - 10;
-               }
-        }
-    }
-
-}
 
 /*
- * Returns true if a cell (x,y) in the cells matrix would survive to the next transition.
- *     Doesn't currently adjust any border cells.
- *
+ * Perform the cellular automata transitions, up to timesteps in total.
  */
-bool transition(int x, int y) {
+void ca_routine(ca_engine_t *engine, ca_grid_t *grid) {
 
-        int livingNeighbors = 0;
+    int time = ca_engine_timestep(engine);
+    int next_checkpoint = time + checkpoint_every;
 
-        for (int nRows = x - 1; nRows <= x + 1; nRows++) {     //Count Living Neighbors
-            for (int nCols = y - 1; nCols <= y + 1; nCols++) {
-                if (*(cells + nRows*MAX_COLS + nCols) == 1) {
-                    livingNeighbors++;
-                }
+    while (1) {
+        // frames are written in the background while the run goes on
+        if (frames != NULL && time % frames_every == 0) {
+            ca_engine_sync(engine);
+            if (ca_frames_write(frames, grid, time) != 0) {
+                exit(EXIT_FAILURE);
             }
-	}
-
-	//subtract current cell
-        livingNeighbors -=  *(cells + x*(MAX_COLS) + y);
-
-        if (*(cells + x*MAX_COLS + y) == 1) {           //Decide if cell will live or perish
-            return (livingNeighbors == 2 || livingNeighbors == 3);
-        } else {
-            return (livingNeighbors == 3);
+        }
+        if (time >= timesteps) {
+            break;
         }
 
-}
+        // step to the next frame or checkpoint, whichever comes first
+        int end = timesteps;
+        if (checkpoint_every > 0 && next_checkpoint < end) {
+            end = next_checkpoint;
+        }
+        if (frames != NULL && (time / frames_every + 1) * frames_every < end) {
+            end = (time / frames_every + 1) * frames_every;
+        }
+        ca_engine_step(engine, end - time);
+        time = end;
 
-/*
- * Print the cellspace.
- *
- * Notice the for loop is from [1, maxrows-1]:
- * this is because of the ghost border.
- */
-void print_cellspace(int* p, int timestep) {
-
-    printf("TIMESTEP # %d\n", timestep);
-    for (int x = 1; x < MAX_ROWS-1; x++) {
-        for (int y = 1; y < MAX_COLS-1; y++) {
-            printf(" %d ", *(p + x*(MAX_COLS) + y)) ;
-       }
-    printf("\n");
+        if (time == timesteps || (checkpoint_every > 0 && time == next_checkpoint)) {
+            if (checkpoint_path != NULL && ca_engine_checkpoint(engine, checkpoint_path) != 0) {
+                exit(EXIT_FAILURE);
+            }
+            next_checkpoint = time + checkpoint_every;
+        }
     }
-    printf("\n");
 
 }
 
+
 /*
- * Perform the cellular automata transitions.
+ * Print usage and exit.
  */
-void ca_routine() {
-
-    int timestep = 0;
-    srand(time(0)); 
-    int r;
-    int c;
-    while (timestep < timesteps) {
-
-        r = (rand() % ((ROWS) - 1 + 1)) + 1;
-        c = (rand() % ((COLS) - 1 + 1)) + 1;
-        if (transition(r,c)) {
-            *(cells + r*(MAX_COLS) + c) = 1;
-        } else {
-            *(cells + r*(MAX_COLS) + c) = 0;
-        }
-
-       if (timestep % 10 == 0 && debug_mode) {
-          print_cellspace(cells, timestep);
-       }
-       timestep++;
-
-    }
-
+void usage() {
 
+    printf("Usage: ./ca_model [--seed n] [--checkpoint file [--checkpoint-every n]] [--restart file] [--pattern file [--pattern-at row,col]] [--frames file [--frames-every n]] [-k int|lut] [-r rule] [-n threads] <rows> <cols> <timestep>\n");
+    exit(EXIT_FAILURE);
 
 }
 
@@ -142,34 +136,134 @@ void ca_routine() {
  */
 int main(int argc, char* argv[])
 {
+    ca_config_t config;
+    ca_config_default(&config);
+    const char *backend = "rand_ind";
+
     // check and parse command line options
-    if (argc != 4) {
-        printf("Usage: ./ca_model <rows> <cols> <timestep>\n");
-        exit(EXIT_FAILURE);
+    static const struct option long_options[] = {
+        {"seed", required_argument, NULL, 'S'},
+        {"checkpoint", required_argument, NULL, 'C'},
+        {"checkpoint-every", required_argument, NULL, 'I'},
+        {"restart", required_argument, NULL, 'R'},
+        {"pattern", required_argument, NULL, 'L'},
+        {"pattern-at", required_argument, NULL, 'O'},
+        {"frames", required_argument, NULL, 'F'},
+        {"frames-every", required_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "k:r:n:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'k':
+            config.kernel = optarg;
+            break;
+        case 'S': {
+            char *end;
+            config.seed = strtoull(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0') {
+                printf("ERROR: seed must be a non-negative integer\n");
+                usage();
+            }
+            break;
+        }
+        case 'r':
+            config.rule = optarg;
+            break;
+        case 'C':
+            checkpoint_path = optarg;
+            break;
+        case 'I':
+            checkpoint_every = atoi(optarg);
+            if (checkpoint_every < 1) {
+                printf("ERROR: checkpoint interval must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'R':
+            config.restart = optarg;
+            break;
+        case 'L':
+            config.pattern = optarg;
+            break;
+        case 'O': {
+            char end;
+            if (sscanf(optarg, "%d,%d%c", &config.pattern_row, &config.pattern_col, &end) != 2
+                    || config.pattern_row < 0 || config.pattern_col < 0) {
+                printf("ERROR: pattern position must be row,col with non-negative integers\n");
+                usage();
+            }
+            break;
+        }
+        case 'F':
+            frames_path = optarg;
+            break;
+        case 'J':
+            frames_every = atoi(optarg);
+            if (frames_every < 1) {
+                printf("ERROR: frame interval must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'n':
+            config.threads = atoi(optarg);
+            if (config.threads < 1) {
+                printf("ERROR: thread_count must be greater than 0\n");
+                usage();
+            }
+            backend = "rand_ind_pthreads";
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind != 3) {
+        usage();
     }
 
-    ROWS = atoi(argv[1]);
-    COLS = atoi(argv[2]);
-    timesteps = atoi(argv[3]);
+    ROWS = atoi(argv[optind]);
+    COLS = atoi(argv[optind+1]);
+    timesteps = atoi(argv[optind+2]);
 
     if (ROWS < 0 || COLS < 0) {
         printf("ERROR: please enter a positive number for rows and cols.\n");
         exit(EXIT_FAILURE);
     }
 
-    /* set max rows/cols for ghost border */
-    MAX_ROWS=ROWS+2;
-    MAX_COLS=COLS+2;
-    cells = (int*) calloc((MAX_ROWS * MAX_COLS), sizeof(int));
+    // ca_engine_create fills the grid, on the backend's threads if it has any
+    ca_grid_t *grid = ca_grid_alloc(ROWS, COLS);
+    config.randomize = true;
 
     START_TIMER(ca);
-    initialize();
-    ca_routine();
+    START_TIMER(init);
+    ca_engine_t *engine = ca_engine_create(backend, grid, &config);
+    if (engine == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    STOP_TIMER(init);
+    // a restart only steps the remaining timesteps
+    int first = ca_engine_timestep(engine);
+    // at most four frames in flight before stepping waits for the disk
+    if (frames_path != NULL && (frames = ca_frames_open(frames_path, engine, 4)) == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    START_TIMER(step);
+    ca_routine(engine, grid);
+    if (frames != NULL && ca_frames_close(frames) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    STOP_TIMER(step);
     STOP_TIMER(ca);
 
-    printf("time for asynchronous random independent program: %4.4fs\n", GET_TIMER(ca));
-    free(cells);
+    char desc[256];
+    ca_engine_describe(engine, desc, sizeof(desc));
+    printf("time for asynchronous random independent program: %4.4fs (%s)\n", GET_TIMER(ca), desc);
+    printf("init: %4.4fs, steps: %4.4fs\n", GET_TIMER(init), GET_TIMER(step));
+    printf("updates per second: %.4e\n", GET_TIMER(step) > 0 && timesteps > first ?
+           (timesteps - first) / GET_TIMER(step) : 0.0);
+    ca_engine_profile(engine);
+    ca_engine_free(engine);
+    ca_grid_free(grid);
     return (EXIT_SUCCESS);
 
 }
-
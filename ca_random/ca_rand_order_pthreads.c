@@ -10,168 +10,118 @@
  * Authors: Paul Bailey, Jenna Horrall, Callan Hand
  *
  * ca_rand_order_pthreads: uses the random order scheme to randomize the matrix.
- * every cell is updated each timestep but in random order. this implementation
- * attempts to use pthreads to parallelize the transitions.
+ * every cell is updated each timestep but in random order. Runs the
+ * rand_order_pthreads backend of libca: the cells are split into four
+ * colors by row and column parity, no two cells of a color are neighbors,
+ * and a persistent pool of threads updates one color at a time in place
+ * without locks. The color order is random each timestep.
+ *
+ * Kernels (-k): int (default) or lut, a 512 entry table indexed by the
+ * packed 3x3 neighborhood.
+ *
+ * Rules (-r): B3/S23 (Game of Life, default), any other Life-like rule
+ * such as B36/S23, or a Generations rule such as B2/S/3. Rules other than
+ * B3/S23 run with the int kernel.
+ *
+ * Barriers (-B):
+ *   spin       sense-reversing spin barrier with a futex fallback (default)
+ *   pthread    pthread_barrier_wait
+ *
+ * Seed (--seed n): the initial cellspace and the update order depend only
+ * on the seed, whatever the thread count. Without --seed it is taken from
+ * the clock; the timing line reports it so a run can be repeated.
+ *
+ * Checkpoints (--checkpoint file): the state of the run is saved to file at
+ * the end and, with --checkpoint-every n, every n timesteps. --restart file
+ * continues a saved run up to <timesteps> in total, with the seed and rule
+ * it was started with; rows and cols have to match.
+ *
+ * Frames (--frames file): the cellspace is written to file every 10
+ * timesteps, or every n with --frames-every n, as a sequence of binary
+ * netpbm images: file.pbm one bit per cell, file.pgm one byte per cell
+ * (needed for Generations rules). A background thread encodes and writes
+ * them while the run goes on.
+ *
+ * Patterns (--pattern file): start from an RLE (.rle) or plaintext (.cells)
+ * Life pattern instead of a random cellspace, centered or with its top left
+ * cell at --pattern-at row,col. The rest of the cellspace starts dead; the
+ * rule comes from the RLE header unless -r is given.
  *
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <time.h>
 #include <stdbool.h>
 #include <string.h>
-#include <pthread.h>
+#include <getopt.h>
 #include "timer.h"
+#include "ca.h"
 
 int ROWS;
 int COLS;
 
-int MAX_ROWS;
-int MAX_COLS;
-
 int timesteps;
-bool debug = false;
-
-int *global_cells;
-int *visited;
-int visited_cells = 0;
 
-void initialize();
-bool transition(int, int);
-void* worker(void* arg);
-void print_cellspace(int*, int);
-void ca_routine(int);
+const char *checkpoint_path = NULL;
+int checkpoint_every = 0;
+const char *frames_path = NULL;
+int frames_every = 10;
+ca_frames_t *frames = NULL;
+void ca_routine(ca_engine_t*, ca_grid_t*);
+void usage();
 
-pthread_mutex_t mut = PTHREAD_MUTEX_INITIALIZER;
 
 /*
- * Randomly generate a matrix of MAX_ROWS x MAX_COLS.
- * Each cell has two possible states: 0 (inactive) or 1 (active).
- * 
- *
+ * Perform the cellular automata transitions, up to timesteps in total.
  */
-void initialize() {
-
-    srand(time(0));
-    for (int x = 0; x < MAX_ROWS; x++) {
-        for (int y = 0; y < MAX_COLS; y++) {
-               // set to outer layer to all 1's to account for border cell transitions
-               if (x == ROWS+1 || x == 0 || y == 0 || y == COLS+1) {
-                   *(global_cells + x*(COLS+2) + y) = 1;
-               } else {
-                   *(global_cells + x*(COLS+2) + y) = (rand() % (11 - 10 + 1) + 10) - 10;  
-               }
-        }
-    }
-
-}
+void ca_routine(ca_engine_t *engine, ca_grid_t *grid) {
 
+    int time = ca_engine_timestep(engine);
+    int next_checkpoint = time + checkpoint_every;
 
-/*
- * Returns true if a cell (x,y) in the cells matrix would survive to the next transition.
- *     Doesn't currently adjust any border cells.
- *
- */
-bool transition(int x, int y) {
-
-	int livingNeighbors = 0;
-
-	for (int nRows = x - 1; nRows <= x + 1; nRows++) {     //Count Living Neighbors
-	    for (int nCols = y - 1; nCols <= y + 1; nCols++) {
-		if (*(global_cells + nRows*MAX_COLS + nCols) == 1) { 
-		    livingNeighbors++;
-		}
-	    }
-	}
-
-        //subtract current cell
-        livingNeighbors -=  *(global_cells + x*(MAX_COLS) + y);
-
-	if (*(global_cells + x*MAX_COLS + y) == 1) {           //Decide if cell will live or perish
-	    return (livingNeighbors == 2 || livingNeighbors == 3);
-	} else {
-	    return (livingNeighbors == 3);
-	}
-
-}
-
-/*
- * Worker thread function.
- */
-void* worker(void* arg) {
-
-    int row_rand = 0;
-    int col_rand = 0;
-    while (visited_cells < ROWS*COLS) {
-            row_rand = (rand() % ((ROWS) - 1 + 1)) + 1;
-            col_rand = (rand() % ((COLS) - 1 + 1)) + 1;
-            pthread_mutex_lock(&mut);
-            if (*(visited + row_rand*(MAX_COLS) + col_rand) == 0) {
-               *(visited + row_rand*(MAX_COLS) + col_rand) = 1;
-               if (transition(row_rand,col_rand)) {
-                   *(global_cells + row_rand*(MAX_COLS) + col_rand) = 1;
-               } else {
-                   *(global_cells + row_rand*(MAX_COLS) + col_rand) = 0;
-               }
-               visited_cells++;
+    while (1) {
+        // frames are written in the background while the run goes on
+        if (frames != NULL && time % frames_every == 0) {
+            ca_engine_sync(engine);
+            if (ca_frames_write(frames, grid, time) != 0) {
+                exit(EXIT_FAILURE);
             }
-            pthread_mutex_unlock(&mut);
-
-    }
-    return NULL;
-}
+        }
+        if (time >= timesteps) {
+            break;
+        }
 
+        // step to the next frame or checkpoint, whichever comes first
+        int end = timesteps;
+        if (checkpoint_every > 0 && next_checkpoint < end) {
+            end = next_checkpoint;
+        }
+        if (frames != NULL && (time / frames_every + 1) * frames_every < end) {
+            end = (time / frames_every + 1) * frames_every;
+        }
+        ca_engine_step(engine, end - time);
+        time = end;
 
-/*
- * Print the cellspace.
- *
- * Notice the for loop is from [1, maxrows-1]:
- * this is because of the ghost border.
- */
-void print_cellspace(int* p, int timestep) {
-
-    printf("TIMESTEP # %d\n", timestep);
-    for (int x = 1; x < MAX_ROWS-1; x++) {
-        for (int y = 1; y < MAX_COLS-1; y++) {
-            printf(" %d ", *(p + x*(MAX_COLS) + y)) ;
-       }
-    printf("\n");
+        if (time == timesteps || (checkpoint_every > 0 && time == next_checkpoint)) {
+            if (checkpoint_path != NULL && ca_engine_checkpoint(engine, checkpoint_path) != 0) {
+                exit(EXIT_FAILURE);
+            }
+            next_checkpoint = time + checkpoint_every;
+        }
     }
-    printf("\n");
 
 }
 
 
 /*
- * Perform the cellular automata transition routine.
+ * Print usage and exit.
  */
-void ca_routine(int threads) {
-
-    int time = 0;
-    while (time < timesteps) {
- 
-        visited_cells = 0;
-        memset(visited, 0, (MAX_ROWS * MAX_COLS* sizeof(int)));
-
-            //initialize and create threads
-            pthread_t* thread_handler = (pthread_t*)calloc(threads, sizeof(pthread_t));
-            for (int i = 0; i < threads; i++) {
-                pthread_create(&thread_handler[i], NULL, worker, (void*)0);
-            }
-             // clean up threads and free allocated memory
-             for (int i = 0; i < threads; i++) {
-                 pthread_join(thread_handler[i], NULL);
-             }
-
+void usage() {
 
-      if (time % 10 == 0 && debug) {
-          print_cellspace(global_cells, time);
-      }
-
-      time++;
-
-    }
+    printf("Usage: ./ca_model [--seed n] [--checkpoint file [--checkpoint-every n]] [--restart file] [--pattern file [--pattern-at row,col]] [--frames file [--frames-every n]] [-k int|lut] [-r rule] [-B spin|pthread] <rows> <cols> <timesteps> <nthreads>\n");
+    exit(EXIT_FAILURE);
 
 }
 
@@ -181,38 +131,137 @@ void ca_routine(int threads) {
  */
 int main(int argc, char* argv[])
 {
+    ca_config_t config;
+    ca_config_default(&config);
+
     // check and parse command line options
-    if (argc != 5) {
-        printf("Usage: ./ca_model <rows> <cols> <timesteps> <nthreads>\n");
-        exit(EXIT_FAILURE);
+    static const struct option long_options[] = {
+        {"seed", required_argument, NULL, 'S'},
+        {"checkpoint", required_argument, NULL, 'C'},
+        {"checkpoint-every", required_argument, NULL, 'I'},
+        {"restart", required_argument, NULL, 'R'},
+        {"pattern", required_argument, NULL, 'L'},
+        {"pattern-at", required_argument, NULL, 'O'},
+        {"frames", required_argument, NULL, 'F'},
+        {"frames-every", required_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "k:r:B:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'k':
+            config.kernel = optarg;
+            break;
+        case 'S': {
+            char *end;
+            config.seed = strtoull(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0') {
+                printf("ERROR: seed must be a non-negative integer\n");
+                usage();
+            }
+            break;
+        }
+        case 'r':
+            config.rule = optarg;
+            break;
+        case 'C':
+            checkpoint_path = optarg;
+            break;
+        case 'I':
+            checkpoint_every = atoi(optarg);
+            if (checkpoint_every < 1) {
+                printf("ERROR: checkpoint interval must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'R':
+            config.restart = optarg;
+            break;
+        case 'L':
+            config.pattern = optarg;
+            break;
+        case 'O': {
+            char end;
+            if (sscanf(optarg, "%d,%d%c", &config.pattern_row, &config.pattern_col, &end) != 2
+                    || config.pattern_row < 0 || config.pattern_col < 0) {
+                printf("ERROR: pattern position must be row,col with non-negative integers\n");
+                usage();
+            }
+            break;
+        }
+        case 'F':
+            frames_path = optarg;
+            break;
+        case 'J':
+            frames_every = atoi(optarg);
+            if (frames_every < 1) {
+                printf("ERROR: frame interval must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'B':
+            if (strcmp(optarg, "spin") == 0) {
+                config.spin_barrier = true;
+            } else if (strcmp(optarg, "pthread") == 0) {
+                config.spin_barrier = false;
+            } else {
+                printf("ERROR: unknown barrier '%s'\n", optarg);
+                usage();
+            }
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind != 4) {
+        usage();
     }
    
-    ROWS = atoi(argv[1]);
-    COLS = atoi(argv[2]);
-    timesteps = atoi(argv[3]);
-    int nthreads = atoi(argv[4]);
+    ROWS = atoi(argv[optind]);
+    COLS = atoi(argv[optind+1]);
+    timesteps = atoi(argv[optind+2]);
+    int nthreads = atoi(argv[optind+3]);
 
     if (ROWS < 0 || COLS < 0) {
         printf("ERROR: please enter a positive number for rows and cols.\n");
         exit(EXIT_FAILURE);
     }
 
-    /* set max rows/cols for ghost border */
-    MAX_ROWS=ROWS+2;
-    MAX_COLS=COLS+2;
-
-    global_cells = (int*) calloc((MAX_ROWS * MAX_COLS), sizeof(int));
-    visited = (int*) calloc((MAX_ROWS * MAX_COLS), sizeof(int));
+    if (nthreads < 1) {
+        printf("ERROR: thread_count must be greater than 0\n");
+        exit(EXIT_FAILURE);
+    }
+    config.threads = nthreads;
+    // ca_engine_create fills the grid, on the backend's threads if it has any
+    ca_grid_t *grid = ca_grid_alloc(ROWS, COLS);
+    config.randomize = true;
 
     START_TIMER(ca);
-    initialize();
-    ca_routine(nthreads);
+    START_TIMER(init);
+    ca_engine_t *engine = ca_engine_create("rand_order_pthreads", grid, &config);
+    if (engine == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    STOP_TIMER(init);
+    // at most four frames in flight before stepping waits for the disk
+    if (frames_path != NULL && (frames = ca_frames_open(frames_path, engine, 4)) == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    START_TIMER(step);
+    ca_routine(engine, grid);
+    if (frames != NULL && ca_frames_close(frames) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    STOP_TIMER(step);
     STOP_TIMER(ca);
 
     /* clean up and exit */
-    printf("time for asynchronous random order program using pthreads: %4.4fs\n", GET_TIMER(ca));
-    free(global_cells);
-    free(visited);
+    char desc[256];
+    ca_engine_describe(engine, desc, sizeof(desc));
+    printf("time for asynchronous random order program using pthreads: %4.4fs (%s)\n", GET_TIMER(ca), desc);
+    printf("init: %4.4fs, steps: %4.4fs\n", GET_TIMER(init), GET_TIMER(step));
+    ca_engine_profile(engine);
+    ca_engine_free(engine);
+    ca_grid_free(grid);
     return (EXIT_SUCCESS);
 }
-
@@ -2,7 +2,9 @@
  * timer.h
  *
  * Custom timing macros for serial/OpenMP programs. Uses omp_get_wtime() if
- * _OPENMP is defined and gettimeofday() otherwise.
+ * _OPENMP is defined and clock_gettime(CLOCK_MONOTONIC) otherwise; neither
+ * jumps with the wall clock, and each timer is a local variable, so threads
+ * can time their own spans.
  *
  * Example:
  *
@@ -16,6 +18,9 @@
  *
  *      printf("tag1: %8.4fs  tag2: %8.4fs\n",
  *          GET_TIMER(tag1), GET_TIMER(tag2));
+ *
+ * For where the time goes inside libca, per thread and phase, build it with
+ * make PROFILE=1 and see ca_engine_profile().
  */
 
 #ifdef _OPENMP
@@ -24,12 +29,13 @@
 #   define STOP_TIMER(X)  _timer_ ## X = omp_get_wtime() - (_timer_ ## X);
 #   define GET_TIMER(X)   (_timer_ ## X)
 #else
-#   include <sys/time.h>
-    struct timeval _tv;
-#   define START_TIMER(X) gettimeofday(&_tv, NULL); \
-        double _timer_ ## X = _tv.tv_sec+(_tv.tv_usec/1000000.0);
-#   define STOP_TIMER(X)  gettimeofday(&_tv, NULL); \
-        _timer_ ## X = _tv.tv_sec+(_tv.tv_usec/1000000.0) - (_timer_ ## X);
+#   include <time.h>
+    static inline double _timer_now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+    }
+#   define START_TIMER(X) double _timer_ ## X = _timer_now();
+#   define STOP_TIMER(X)  _timer_ ## X = _timer_now() - (_timer_ ## X);
 #   define GET_TIMER(X)   (_timer_ ## X)
 #endif
-
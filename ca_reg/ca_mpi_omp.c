@@ -19,218 +19,327 @@
  * The global matrix is distributed among procs and within each proc, the updates are
  * parallelized using OpenMP.
  *
+ * Both run the mpi backend of libca (libca_mpi / libca_mpi_omp).
+ *
+ * Kernels (-k): int (default) or lut, a 512 entry table indexed by the
+ * packed 3x3 neighborhood.
+ *
+ * Rules (-r): B3/S23 (Game of Life, default), any other Life-like rule
+ * such as B36/S23, or a Generations rule such as B2/S/3. Rules other than
+ * B3/S23 run with the int kernel.
+ *
+ * Communication modes (-c):
+ *   allgather  every rank gathers the whole cellspace after each timestep (default)
+ *   halo       every rank keeps only its own block plus a one cell ghost ring
+ *              and exchanges just those boundary cells with its neighbors each
+ *              timestep. The full cellspace is only assembled on rank 0 when it
+ *              is printed.
+ *
+ * Decomposition for halo mode (-d):
+ *   1d         row slabs, one block per rank across the full width (default)
+ *   2d         2D blocks on an MPI_Cart_create grid, shaped for the shortest
+ *              halo among the factorizations of nprocs that fit.
+ *              Rows and cols don't have to divide evenly, so any grid size
+ *              works with any number of procs.
+ *
+ * Overlap (-o, halo mode): the ghost ring exchange is posted with non-blocking
+ * sends/receives, the interior cells that don't touch the ghost ring are
+ * updated while the messages are in flight, and the boundary cells are
+ * finished after MPI_Waitall. The timing line reports how much of the
+ * exchange was hidden behind the interior update.
+ *
+ * Affinity (-P): pin each rank (ca_mpi) or each rank's OpenMP threads
+ * (ca_mpi_omp) to CPUs. Ranks on one node split its CPUs between them, so
+ * start with mpirun --bind-to none. Rank 0 prints every rank's placement
+ * map at startup.
+ *   compact    fill the cores of one node before the next
+ *   scatter    deal the threads round-robin over the nodes
+ *   0,2,4-7    explicit CPU list, thread t on the t-th CPU
+ *
+ * Seed (--seed n): the initial cellspace depends only on the seed. Without
+ * --seed it is taken from the clock; the timing line reports it so a run
+ * can be repeated.
+ *
+ * Snapshots (--snapshot file): every rank writes its own part of the
+ * cellspace into file with collective MPI-IO at the end and, with
+ * --snapshot-every n, every n timesteps. Cells take a byte each, or a bit
+ * with --snapshot-packed (two state rules, allgather or -d 1d). A snapshot
+ * is a checkpoint file: --restart file continues it up to <timesteps> in
+ * total, here or with any other synchronous program, e.g. ca_serial.
+ *
+ * Frames (--frames file): rank 0 writes the cellspace to file every 10
+ * timesteps, or every n with --frames-every n, as a sequence of binary
+ * netpbm images: file.pbm one bit per cell, file.pgm one byte per cell
+ * (needed for Generations rules). A background thread on rank 0 encodes and
+ * writes them while the run goes on.
+ *
+ * Patterns (--pattern file): start from an RLE (.rle) or plaintext (.cells)
+ * Life pattern instead of a random cellspace, each rank parsing only its
+ * own part of the file. The pattern is centered or has its top left cell
+ * at --pattern-at row,col. The rest of the cellspace starts dead; the rule
+ * comes from the RLE header unless -r is given.
+ *
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <time.h>
 #include <stdbool.h>
 #include <string.h>
+#include <getopt.h>
 #include "timer.h"
 #include <mpi.h>
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
+#include "ca.h"
+#include "ca_mpi.h"
 
 int ROWS;
 int COLS;
 
-int MAX_ROWS;
-int MAX_COLS;
-
 int my_rank;
 int nprocs;
 
-bool debug = false;
-
-int *global_cells;
-int *local_cells;
+const char *snapshot_path = NULL;
+int snapshot_every = 0;
+bool snapshot_packed = false;
+int snapshots = 0;
+double snapshot_time = 0.0;
+const char *frames_path = NULL;
+int frames_every = 10;
+ca_frames_t *frames = NULL;
 
 int timesteps;
 
-void initialize();
-bool transition(int, int);
-void print_cellspace(int*, int, int, int);
-void print_full_cellspace(int*, int, int, int);
-void ca_routine();
-void err_check();
+void ca_routine(ca_engine_t*, ca_grid_t*);
+void print_placement(ca_engine_t*);
+void usage();
+
 
 /*
- * Randomly generate a matrix of MAX_ROWS x MAX_COLS.
- * Each cell has two possible states: 0 (inactive) or 1 (active).
- *
+ * Perform the cellular automata transitions, up to timesteps in total. The
+ * cellspace is only assembled on rank 0 for a frame.
  */
-void initialize()
+void ca_routine(ca_engine_t *engine, ca_grid_t *grid)
 {
 
-    srand(time(0));
-    for (int x = 0; x < MAX_ROWS; x++) {
-        for (int y = 0; y < MAX_COLS; y++) {
-            // set to outer layer to all 1's to account for border cell transitions
-            if (x == ROWS+1 || x == 0 || y == 0 || y == COLS+1) {
-                *(global_cells + x*(COLS+2) + y) = 1;
-            } else {
-                *(global_cells + x*(COLS+2) + y) = (rand() % (11 - 10 + 1) + 10) - 10;
+    int time = ca_engine_timestep(engine);
+    int next_snapshot = time + snapshot_every;
+
+    while (1) {
+        // every rank joins the sync, rank 0 queues the frame for its writer
+        if (frames_path != NULL && time % frames_every == 0) {
+            ca_engine_sync(engine);
+            if (my_rank == 0 && ca_frames_write(frames, grid, time) != 0) {
+                MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
             }
         }
-    }
-
-}
-
-
-/*
- * Returns true if a cell (x,y) in the cells matrix would survive to the next transition.
- *     Doesn't currently adjust any border cells.
- *
- */
-bool transition(int x, int y)
-{
+        if (time >= timesteps) {
+            break;
+        }
 
-    int livingNeighbors = 0;
-    for (int nRows = x - 1; nRows <= x + 1; nRows++) {     //Count Living Neighbors
-        for (int nCols = y - 1; nCols <= y + 1; nCols++) {
-            if (*(global_cells + nRows*MAX_COLS + nCols) == 1) {
-                livingNeighbors++;
+        // step to the next frame or snapshot, whichever comes first
+        int end = timesteps;
+        if (snapshot_every > 0 && next_snapshot < end) {
+            end = next_snapshot;
+        }
+        if (frames_path != NULL && (time / frames_every + 1) * frames_every < end) {
+            end = (time / frames_every + 1) * frames_every;
+        }
+        ca_engine_step(engine, end - time);
+        time = end;
+
+        if (time == timesteps || (snapshot_every > 0 && time == next_snapshot)) {
+            if (snapshot_path != NULL) {
+                double start = MPI_Wtime();
+                if (ca_mpi_snapshot(engine, snapshot_path, snapshot_packed) != 0) {
+                    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+                }
+                snapshot_time += MPI_Wtime() - start;
+                snapshots++;
             }
+            next_snapshot = time + snapshot_every;
         }
     }
 
-    //subtract current cell
-    livingNeighbors -=  *(global_cells + x*(MAX_COLS) + y);
-
-    if (*(global_cells + x*MAX_COLS + y) == 1) {           //Decide if cell will live or perish
-        return (livingNeighbors == 2 || livingNeighbors == 3);
-    } else {
-        return (livingNeighbors == 3);
-    }
-
 }
 
 
 
 /*
- * Print the cellspace.
- *
- * Notice the for loop is from [1, maxrows-1]:
- * this is because of the ghost border.
+ * Gather the placement map of every rank on rank 0 and print it.
  */
-void print_cellspace(int* p, int timestep, int rows, int cols)
+void print_placement(ca_engine_t *engine)
 {
 
-    printf("TIMESTEP # %d\n", timestep);
-    for (int x = 1; x < rows-1; x++) {
-        for (int y = 1; y < cols-1; y++) {
-            printf(" %d ", *(p + x*(cols) + y)) ;
+    const int map_len = 8192;
+    char *map = (char*) malloc(map_len);
+    char *maps = (my_rank == 0) ? (char*) malloc((size_t)nprocs * map_len) : NULL;
+    char host[MPI_MAX_PROCESSOR_NAME];
+    int host_len;
+
+    MPI_Get_processor_name(host, &host_len);
+    int n = snprintf(map, map_len, "rank %d (%s):\n", my_rank, host);
+    ca_engine_placement(engine, map + n, map_len - n);
+    MPI_Gather(map, map_len, MPI_CHAR, maps, map_len, MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (my_rank == 0) {
+        printf("placement:\n");
+        for (int r = 0; r < nprocs; r++) {
+            printf("%s", maps + (size_t)r * map_len);
         }
-        printf("\n");
     }
-    printf("\n");
+    free(map);
+    free(maps);
 
 }
 
 
+
 /*
- * Print the entire cellspace including the ghost border.
- *
- * 
+ * Print usage and exit.
  */
-void print_full_cellspace(int* p, int timestep, int rows, int cols)
+void usage()
 {
 
-    printf("TIMESTEP # %d\n", timestep);
-    for (int x = 0; x < rows; x++) {
-        for (int y = 0; y < cols; y++) {
-            printf(" %d ", *(p + x*(cols) + y)) ;
-        }
-        printf("\n");
-    }
-    printf("\n");
+    printf("Usage: ./ca_mpi [--seed n] [--snapshot file [--snapshot-every n] [--snapshot-packed]] [--restart file] [--pattern file [--pattern-at row,col]] [--frames file [--frames-every n]] [-k int|lut] [-r rule] [-c allgather|halo] [-d 1d|2d] [-o] [-P compact|scatter|cpus] <rows> <cols> <timesteps> \n");
+    exit(EXIT_FAILURE);
 
 }
 
+
+
 /*
- * Perform the main cellular automata transition loop.
+ * Main routine.
  */
-void ca_routine()
+int main(int argc, char* argv[])
 {
+    ca_config_t config;
+    ca_config_default(&config);
 
-    // distribute cells among procs
-    if (MPI_Scatter(global_cells, ((MAX_ROWS / nprocs) * MAX_COLS), MPI_INT,
-                    local_cells, ((MAX_ROWS / nprocs) * MAX_COLS), MPI_INT,
-                    0, MPI_COMM_WORLD) != MPI_SUCCESS) {
-        perror("Scatter error in CA routine");
-        exit(1);
-    }
-
-
-    int begin_time = 0;
-    int start_rows = 0;
-    int end_rows = 0;
-    int index_rows_in_local = 0;
-
-    while (begin_time < timesteps) {
-
-        // compute indices in global array
-        if (my_rank == 0) {
-            start_rows = 1;
-            end_rows = MAX_ROWS / nprocs;
-            index_rows_in_local = 1;
-        } else if (my_rank == nprocs - 1) {
-            start_rows = my_rank * (MAX_ROWS / nprocs);
-            end_rows = start_rows + (MAX_ROWS / nprocs) - 1;
-            index_rows_in_local = 0;
-        } else {
-            index_rows_in_local = 0;
-            start_rows = my_rank * (MAX_ROWS / nprocs);
-            end_rows = start_rows + (MAX_ROWS / nprocs);
-        }
-
-        # pragma omp parallel for
-        for (int i = start_rows; i < end_rows; i++) {
-            for (int j = 1; j < MAX_COLS-1; j++) {
-                if (transition(i,j)) {
-                    *(local_cells + index_rows_in_local*(MAX_COLS) + j) = 1;
-                } else {
-                    *(local_cells + index_rows_in_local*(MAX_COLS) + j) = 0;
-                }
-
+    // check and parse command line options
+    static const struct option long_options[] = {
+        {"seed", required_argument, NULL, 'S'},
+        {"snapshot", required_argument, NULL, 'W'},
+        {"snapshot-every", required_argument, NULL, 'I'},
+        {"snapshot-packed", no_argument, NULL, 'B'},
+        {"restart", required_argument, NULL, 'R'},
+        {"pattern", required_argument, NULL, 'L'},
+        {"pattern-at", required_argument, NULL, 'O'},
+        {"frames", required_argument, NULL, 'F'},
+        {"frames-every", required_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "k:c:d:or:P:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'k':
+            config.kernel = optarg;
+            break;
+        case 'S': {
+            char *end;
+            config.seed = strtoull(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0') {
+                printf("ERROR: seed must be a non-negative integer\n");
+                usage();
             }
-            index_rows_in_local++;
+            break;
         }
-
-        MPI_Barrier(MPI_COMM_WORLD);
-
-        if (MPI_Allgather(local_cells, ((MAX_ROWS / nprocs) * MAX_COLS), MPI_INT,
-                          global_cells, ((MAX_ROWS / nprocs) * MAX_COLS), MPI_INT,
-                          MPI_COMM_WORLD) != MPI_SUCCESS) {
-
-            perror("Gather error");
-            exit(1);
+        case 'r':
+            config.rule = optarg;
+            break;
+        case 'W':
+            snapshot_path = optarg;
+            break;
+        case 'I':
+            snapshot_every = atoi(optarg);
+            if (snapshot_every < 1) {
+                printf("ERROR: snapshot interval must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'B':
+            snapshot_packed = true;
+            break;
+        case 'R':
+            config.restart = optarg;
+            break;
+        case 'L':
+            config.pattern = optarg;
+            break;
+        case 'O': {
+            char end;
+            if (sscanf(optarg, "%d,%d%c", &config.pattern_row, &config.pattern_col, &end) != 2
+                    || config.pattern_row < 0 || config.pattern_col < 0) {
+                printf("ERROR: pattern position must be row,col with non-negative integers\n");
+                usage();
+            }
+            break;
         }
-
-        // print matrix if debug mode is on
-        if (my_rank == 0 && begin_time % 10 == 0 && debug) {
-            print_cellspace(global_cells, begin_time, MAX_ROWS, MAX_COLS);
+        case 'F':
+            frames_path = optarg;
+            break;
+        case 'J':
+            frames_every = atoi(optarg);
+            if (frames_every < 1) {
+                printf("ERROR: frame interval must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'P':
+            config.affinity = optarg;
+            break;
+        case 'c':
+            if (strcmp(optarg, "allgather") == 0) {
+                config.halo = false;
+            } else if (strcmp(optarg, "halo") == 0) {
+                config.halo = true;
+            } else {
+                printf("ERROR: unknown communication mode '%s'\n", optarg);
+                usage();
+            }
+            break;
+        case 'o':
+            // overlapping communication needs the non-blocking halo exchange
+            config.overlap = true;
+            config.halo = true;
+            break;
+        case 'd':
+            if (strcmp(optarg, "1d") == 0) {
+                config.decomp_2d = false;
+            } else if (strcmp(optarg, "2d") == 0) {
+                // a 2D decomposition only makes sense with halo exchange
+                config.decomp_2d = true;
+                config.halo = true;
+            } else {
+                printf("ERROR: unknown decomposition '%s'\n", optarg);
+                usage();
+            }
+            break;
+        default:
+            usage();
         }
-
-        MPI_Barrier(MPI_COMM_WORLD);
-
-        begin_time++;
-
-
+    }
+    if (argc - optind != 3) {
+        usage();
     }
 
+    ROWS = atoi(argv[optind]);
+    COLS = atoi(argv[optind+1]);
+    timesteps = atoi(argv[optind+2]);
 
-}
+    if (ROWS < 0 || COLS < 0) {
+        printf("ERROR: please enter a positive number for rows and cols.\n");
+        exit(EXIT_FAILURE);
+    }
 
-/*
- * Check to make sure num rows is valid.
- */
-void err_check() {
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+    ca_mpi_register();
 
-    if ((ROWS+2) % nprocs != 0) {
+    // allgather mode splits the rows with their ghost border evenly; this
+    // program has always stopped here, with success, when they don't
+    if (!config.halo && (ROWS + 2) % nprocs != 0) {
         if (my_rank == 0) {
             printf("\n------------------\n");
             printf("ERROR: To ensure that the matrix is distributed evenly between the procs, please enter a valid rows amount.\n");
@@ -240,66 +349,62 @@ void err_check() {
         }
         MPI_Finalize();
         exit(EXIT_SUCCESS);
-
     }
-}
 
+    // every rank reports rank 0's seed
+    MPI_Bcast(&config.seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
 
+    // only rank 0 needs the global cell matrix; every rank fills its own
+    // part of the cellspace in ca_engine_create
+    ca_grid_t *grid = (my_rank == 0) ? ca_grid_alloc(ROWS, COLS) : ca_grid_shape(ROWS, COLS);
+    config.randomize = true;
 
-/*
- * Main routine.
- */
-int main(int argc, char* argv[])
-{
-    // check and parse command line options
-    if (argc != 4) {
-        printf("Usage: ./ca_mpi <rows> <cols> <timesteps> \n");
+    // start time and perform main CA loop
+    START_TIMER(ca);
+    START_TIMER(init);
+    ca_engine_t *engine = ca_engine_create("mpi", grid, &config);
+    if (engine == NULL) {
+        MPI_Finalize();
         exit(EXIT_FAILURE);
     }
-
-    ROWS = atoi(argv[1]);
-    COLS = atoi(argv[2]);
-    timesteps = atoi(argv[3]);
-
-    if (ROWS < 0 || COLS < 0) {
-        printf("ERROR: please enter a positive number for rows and cols.\n");
-        exit(EXIT_FAILURE);
+    STOP_TIMER(init);
+    if (config.affinity != NULL) {
+        print_placement(engine);
+    }
+    // at most four frames in flight before stepping waits for the disk
+    if (frames_path != NULL && my_rank == 0 &&
+            (frames = ca_frames_open(frames_path, engine, 4)) == NULL) {
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    }
+    START_TIMER(step);
+    ca_routine(engine, grid);
+    ca_engine_sync(engine);
+    if (frames != NULL && ca_frames_close(frames) != 0) {
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
     }
-
-    /* set max rows/cols for ghost border */
-    MAX_ROWS=ROWS+2;
-    MAX_COLS=COLS+2;
-
-    // allocate memory for global cell matrix
-    global_cells = (int*) calloc((MAX_ROWS * MAX_COLS), sizeof(int));
-
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
-
-    err_check();
-
-    // allocate mem for local arrays
-    local_cells = (int*) calloc(((MAX_ROWS / nprocs) * MAX_COLS), sizeof(int));
-
-    // start time and perform main CA loop
-    START_TIMER(ca);
-    initialize();
-    ca_routine();
     MPI_Barrier(MPI_COMM_WORLD);
+    STOP_TIMER(step);
     STOP_TIMER(ca);
 
-    // clean up, print timing results, and return
-    free(local_cells);
-    free(global_cells);
-    MPI_Finalize();
+    // collective: reduces the halo timings onto rank 0
+    char desc[256];
+    ca_engine_describe(engine, desc, sizeof(desc));
+
+    // print timing results, the profile (collective too), clean up, and return
     if (my_rank == 0) {
         #ifdef _OPENMP
-        printf("time for synchronous MPI/OpenMP hybrid program: %4.4fs\n", GET_TIMER(ca));
+        printf("time for synchronous MPI/OpenMP hybrid program: %4.4fs (%s)\n", GET_TIMER(ca), desc);
         #else
-        printf("time for synchronous MPI program: %4.4fs\n", GET_TIMER(ca));
+        printf("time for synchronous MPI program: %4.4fs (%s)\n", GET_TIMER(ca), desc);
         #endif
+        printf("init: %4.4fs, steps: %4.4fs\n", GET_TIMER(init), GET_TIMER(step));
+        if (snapshots > 0) {
+            printf("snapshots: %d, %4.4fs\n", snapshots, snapshot_time);
+        }
     }
+    ca_engine_profile(engine);
+    ca_engine_free(engine);
+    ca_grid_free(grid);
+    MPI_Finalize();
     return (EXIT_SUCCESS);
 }
-
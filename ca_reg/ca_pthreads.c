@@ -1,124 +1,148 @@
-/* 
+/*
  *
  * Main Cellular Automata Function using Pthreads
  *
  * Acknowledgements:
  * Game of Life transitions - https://natureofcode.com/book/chapter-7-cellular-automata/
- * 
+ *
  * Dr. Lam: file "timer.h", also used in p3 to calculate runtimes for specific code segments.
  *
  * Authors: Paul Bailey, Jenna Horrall, Callan Hand
  *
- * ca_pthreads: Parallel implementation of the synchronous ca model using pthreads. 
- * The updates of the global cellspace are split among worker threads.
+ * ca_pthreads: Parallel implementation of the synchronous ca model using pthreads.
+ * The updates of the global cellspace are split among worker threads, using
+ * the pthreads backend of libca.
+ *
+ * The worker threads are created once and step the whole run. Each thread
+ * owns a band of rows (any thread count works) and swaps between two buffers
+ * after every timestep, with one barrier per timestep.
+ *
+ * Kernels (-k):
+ *   int        one int per cell, transition evaluated per cell (default)
+ *   lut        3x3 neighborhood packed into an index into a 512 entry table
+ *   bitpacked  64 cells per uint64_t word, word-parallel step
+ *   simd       vectorized row kernel, best of avx512/avx2/sse2 for this CPU;
+ *              avx512, avx2, sse2 or scalar force one
+ *
+ * Rules (-r): B3/S23 (Game of Life, default), any other Life-like rule
+ * such as B36/S23, or a Generations rule such as B2/S/3. Rules other than
+ * B3/S23 run with the int kernel: common rules on a kernel specialized at
+ * compile time, the rest on a table.
+ *
+ * Activity tracking (-a tile): the grid is split into tile x tile blocks and
+ * only blocks that changed in the last timestep, or border one that did,
+ * are recomputed. The timing line reports the share of tiles skipped.
+ *
+ * Barriers (-B):
+ *   spin       sense-reversing spin barrier with a futex fallback (default)
+ *   pthread    pthread_barrier_wait
+ *
+ * Affinity (-P): pin the worker threads to CPUs and bind the rows each one
+ * updates to the memory of its NUMA node. The placement map is printed at
+ * startup.
+ *   compact    fill the cores of one node before the next
+ *   scatter    deal the threads round-robin over the nodes
+ *   0,2,4-7    explicit CPU list, thread t on the t-th CPU
+ *
+ * Seed (--seed n): the initial cellspace depends only on the seed. Without
+ * --seed it is taken from the clock; the timing line reports it so a run
+ * can be repeated.
+ *
+ * Checkpoints (--checkpoint file): the state of the run is saved to file at
+ * the end and, with --checkpoint-every n, every n timesteps. --restart file
+ * continues a saved run up to <timesteps> in total, with the seed and rule
+ * it was started with; rows and cols have to match.
+ *
+ * Frames (--frames file): the cellspace is written to file every 10
+ * timesteps, or every n with --frames-every n, as a sequence of binary
+ * netpbm images: file.pbm one bit per cell, file.pgm one byte per cell
+ * (needed for Generations rules). A background thread encodes and writes
+ * them while the run goes on.
+ *
+ * Patterns (--pattern file): start from an RLE (.rle) or plaintext (.cells)
+ * Life pattern instead of a random cellspace, centered or with its top left
+ * cell at --pattern-at row,col. The rest of the cellspace starts dead; the
+ * rule comes from the RLE header unless -r is given.
  *
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <time.h>
 #include <stdbool.h>
-#include <pthread.h>
+#include <string.h>
+#include <getopt.h>
 #include "timer.h"
+#include "ca.h"
 
 int ROWS;
 int COLS;
-int MAX_ROWS;
-int MAX_COLS;
 
-bool debug_mode = false;
 int timesteps;
 
-/*global matrix*/
-int *cells;
-/*buffer matrix*/
-int *next_transition;
+const char *checkpoint_path = NULL;
+int checkpoint_every = 0;
+const char *frames_path = NULL;
+int frames_every = 10;
+ca_frames_t *frames = NULL;
 
 int thread_count;
-pthread_mutex_t nextTran_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_barrier_t barrier_p;
 
-void initialize();
-bool transition(int, int);
-void print_cellspace(int*, int);
-void *worker(void* rank);
-void lock(pthread_mutex_t *mut);
-void unlock(pthread_mutex_t *mut);
-void destroy(pthread_mutex_t *mut);
-void barrier_wait(pthread_barrier_t *bar);
-void destroy_barrier(pthread_barrier_t *bar);
+void ca_routine(ca_engine_t*, ca_grid_t*);
+void usage();
 
 
 /*
- * Randomly generate a matrix of MAX_ROWS x MAX_COLS.
- * Each cell has two possible states: 0 (inactive) or 1 (active).
- * 
- *
+ * Perform the cellular automata transitions, up to timesteps in total.
  */
-void initialize() {
+void ca_routine(ca_engine_t *engine, ca_grid_t *grid) {
+
+    int time = ca_engine_timestep(engine);
+    int next_checkpoint = time + checkpoint_every;
+
+    while (1) {
+        // frames are written in the background while the run goes on
+        if (frames != NULL && time % frames_every == 0) {
+            ca_engine_sync(engine);
+            if (ca_frames_write(frames, grid, time) != 0) {
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (time >= timesteps) {
+            break;
+        }
 
-    srand(time(0));
-    for (int x = 0; x < MAX_ROWS; x++) {
-        for (int y = 0; y < MAX_COLS; y++) {
-               // set to outer layer to all 1's to account for border cell transitions
-               if (x == ROWS+1 || x == 0 || y == 0 || y == COLS+1) {
-                   *(cells + x*(COLS+2) + y) = 1;
-               } else {
-                   *(cells + x*(COLS+2) + y) = (rand() % (11 - 10 + 1) + 10) - 10;  
-               }
+        // step to the next frame or checkpoint, whichever comes first
+        int end = timesteps;
+        if (checkpoint_every > 0 && next_checkpoint < end) {
+            end = next_checkpoint;
+        }
+        if (frames != NULL && (time / frames_every + 1) * frames_every < end) {
+            end = (time / frames_every + 1) * frames_every;
+        }
+        ca_engine_step(engine, end - time);
+        time = end;
+
+        if (time == timesteps || (checkpoint_every > 0 && time == next_checkpoint)) {
+            if (checkpoint_path != NULL && ca_engine_checkpoint(engine, checkpoint_path) != 0) {
+                exit(EXIT_FAILURE);
+            }
+            next_checkpoint = time + checkpoint_every;
         }
     }
 
 }
 
 
-/*
- * Returns true if a cell (x,y) in the cells matrix would survive to the next transition.
- *     Doesn't currently adjust any border cells.
- *
- */
-bool transition(int x, int y) {
-
-	int livingNeighbors = 0;
-
-	for (int nRows = x - 1; nRows <= x + 1; nRows++) {     //Count Living Neighbors
-	    for (int nCols = y - 1; nCols <= y + 1; nCols++) {
-		if (*(cells + nRows*MAX_COLS + nCols) == 1) { 
-		    livingNeighbors++;
-		}
-	    }
-	}
-
-        //subtract current cell
-        livingNeighbors -=  *(cells + x*(MAX_COLS) + y);
-
-	if (*(cells + x*MAX_COLS + y) == 1) {           //Decide if cell will live or perish
-	    return (livingNeighbors == 2 || livingNeighbors == 3);
-	} else {
-	    return (livingNeighbors == 3);
-	}
-
-}
-
-
 
 /*
- * Print the cellspace.
- *
- * Notice the for loop is from [1, maxrows-1]:
- * this is because of the ghost border.
+ * Print usage and exit.
  */
-void print_cellspace(int* p, int timestep) {
+void usage() {
 
-    printf("TIMESTEP # %d\n", timestep);
-    for (int x = 1; x < MAX_ROWS-1; x++) {
-        for (int y = 1; y < MAX_COLS-1; y++) {
-            printf(" %d ", *(p + x*(MAX_COLS) + y)) ;
-       }
-    printf("\n");
-    }
-    printf("\n");
+    printf("Usage: ./ca_pthreads [--seed n] [--checkpoint file [--checkpoint-every n]] [--restart file] [--pattern file [--pattern-at row,col]] [--frames file [--frames-every n]] [-k int|lut|bitpacked|simd] [-r rule] [-a tile] [-B spin|pthread] [-P compact|scatter|cpus] <rows> <cols> <timesteps> <threads>\n");
+    exit(EXIT_FAILURE);
 
 }
 
@@ -129,159 +153,157 @@ void print_cellspace(int* p, int timestep) {
  */
 int main(int argc, char* argv[])
 {
-    long thread;
-    pthread_t* thread_handles;
+    ca_config_t config;
+    ca_config_default(&config);
 
     // check and parse command line options
-    if (argc != 5) {
-        printf("Usage: ./ca_pthreads <rows> <cols> <timesteps> <threads>\n");
-        exit(EXIT_FAILURE);
+    static const struct option long_options[] = {
+        {"seed", required_argument, NULL, 'S'},
+        {"checkpoint", required_argument, NULL, 'C'},
+        {"checkpoint-every", required_argument, NULL, 'I'},
+        {"restart", required_argument, NULL, 'R'},
+        {"pattern", required_argument, NULL, 'L'},
+        {"pattern-at", required_argument, NULL, 'O'},
+        {"frames", required_argument, NULL, 'F'},
+        {"frames-every", required_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "k:B:a:r:P:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'k':
+            config.kernel = optarg;
+            break;
+        case 'S': {
+            char *end;
+            config.seed = strtoull(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0') {
+                printf("ERROR: seed must be a non-negative integer\n");
+                usage();
+            }
+            break;
+        }
+        case 'r':
+            config.rule = optarg;
+            break;
+        case 'C':
+            checkpoint_path = optarg;
+            break;
+        case 'I':
+            checkpoint_every = atoi(optarg);
+            if (checkpoint_every < 1) {
+                printf("ERROR: checkpoint interval must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'R':
+            config.restart = optarg;
+            break;
+        case 'L':
+            config.pattern = optarg;
+            break;
+        case 'O': {
+            char end;
+            if (sscanf(optarg, "%d,%d%c", &config.pattern_row, &config.pattern_col, &end) != 2
+                    || config.pattern_row < 0 || config.pattern_col < 0) {
+                printf("ERROR: pattern position must be row,col with non-negative integers\n");
+                usage();
+            }
+            break;
+        }
+        case 'F':
+            frames_path = optarg;
+            break;
+        case 'J':
+            frames_every = atoi(optarg);
+            if (frames_every < 1) {
+                printf("ERROR: frame interval must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'B':
+            if (strcmp(optarg, "spin") == 0) {
+                config.spin_barrier = true;
+            } else if (strcmp(optarg, "pthread") == 0) {
+                config.spin_barrier = false;
+            } else {
+                printf("ERROR: unknown barrier '%s'\n", optarg);
+                usage();
+            }
+            break;
+        case 'P':
+            config.affinity = optarg;
+            break;
+        case 'a':
+            config.tile_size = atoi(optarg);
+            if (config.tile_size < 1) {
+                printf("ERROR: tile size must be greater than 0\n");
+                usage();
+            }
+            break;
+        default:
+            usage();
+        }
+    }
+    if (argc - optind != 4) {
+        usage();
     }
-   
-    ROWS = atoi(argv[1]);
-    COLS = atoi(argv[2]);
-    timesteps = atoi(argv[3]);
+
+    ROWS = atoi(argv[optind]);
+    COLS = atoi(argv[optind+1]);
+    timesteps = atoi(argv[optind+2]);
 
     if (ROWS < 0 || COLS < 0) {
         printf("ERROR: please enter a positive number for rows and cols.\n");
         exit(EXIT_FAILURE);
     }
 
-    /* set max rows/cols for ghost border */
-    MAX_ROWS=ROWS+2;
-    MAX_COLS=COLS+2;
-
-    cells = (int*) calloc((MAX_ROWS * MAX_COLS), sizeof(int));
-    next_transition = (int*) calloc((MAX_ROWS * MAX_COLS), sizeof(int));
-
-
     // determine number of threads
-    thread_count = strtol(argv[4], NULL, 10);
+    thread_count = strtol(argv[optind+3], NULL, 10);
     if (thread_count < 1) {
         printf("ERROR: thread_count must be greater than 0\n");
         exit(EXIT_FAILURE);
-    } else if ((MAX_ROWS % thread_count) != 0) {
-	printf("ERROR: please use thread_count that divides Rows\n");
-	exit(EXIT_FAILURE);
     }
-    thread_handles = malloc (thread_count*sizeof(pthread_t));
-
-    // set up barrier for threads to use between timesteps.
+    config.threads = thread_count;
     printf("thread_count : %d\n", thread_count);
-    if (pthread_barrier_init(&barrier_p, NULL, thread_count) != 0) {
-        printf("ERROR: could not initialize the barrier\n");
-        exit(EXIT_FAILURE);
-    }
 
-    START_TIMER(ca);
-    initialize();
-    for (thread = 0; thread < thread_count; thread++) {
-        pthread_create(&thread_handles[thread], NULL, worker, (void*) thread);
-    }
-    for (thread = 0; thread < thread_count; thread++) {
-        pthread_join(thread_handles[thread], NULL);
-    }
-    STOP_TIMER(ca);
-
-    // print results, clean up, and exit
-    printf("time for synchronous pthreads program: %4.4fs\n", GET_TIMER(ca));
-    free(cells);
-    free(thread_handles);
-    destroy_barrier(&barrier_p);
-    destroy(&nextTran_mutex);    
-    return (EXIT_SUCCESS);
-	
-}
-
-
-/* ================== THREAD FUNCTION =============== */
-
-void* worker(void* rank) {
+    // ca_engine_create fills the grid, on the backend's threads if it has any
+    ca_grid_t *grid = ca_grid_alloc(ROWS, COLS);
+    config.randomize = true;
 
-    int my_rank;
-    my_rank = (long)rank;
-
-    int myStart = (my_rank * (ROWS/thread_count)) + 1;
-    int myEnd = myStart + (ROWS/thread_count);
-    int timestep = 0;
-
-        
-    // loop for x time steps
-    while (timestep <= timesteps) {
-
-       for (int i = myStart; i < myEnd; i++) {
-           for (int j = 1; j < MAX_COLS-1; j++) {
-               // if cell can move, perform transition else keep previous value
-               if (transition(i,j)) {
-		   *(next_transition + i*(MAX_COLS) + j) = 1;
-	       } else {
-                   *(next_transition + i*(MAX_COLS) + j) = 0;
-               }
-    	   }
-       }
-
-       // wait for all threads to finish updates
-       barrier_wait(&barrier_p);
-
-       // set the cells grid to the next transition
-       if (rank == 0) {
-	   lock(&nextTran_mutex);
-       	   cells = next_transition;
-           unlock(&nextTran_mutex);
-
-           if (timestep % 10 == 0 && debug_mode) {
-               print_cellspace(cells, timestep);
-           }
-       }
-       timestep++;
-
-    }
-
-    return NULL;
-}
-
-
-
-/* ================= Function Wrappers =============== */
-
-// lock mutex
-void lock(pthread_mutex_t *mut) {
-    if (pthread_mutex_lock(mut) != 0) {
-        printf("ERROR: could not acquire mutex\n");
+    START_TIMER(ca);
+    START_TIMER(init);
+    ca_engine_t *engine = ca_engine_create("pthreads", grid, &config);
+    if (engine == NULL) {
         exit(EXIT_FAILURE);
     }
-}
-
-// unlock mutex
-void unlock(pthread_mutex_t *mut) {
-    if (pthread_mutex_unlock(mut) != 0) {
-        printf("ERROR: could not acquire mutex\n");
-        exit(EXIT_FAILURE);
+    STOP_TIMER(init);
+    if (config.affinity != NULL) {
+        char map[8192];
+        ca_engine_placement(engine, map, sizeof(map));
+        printf("placement:\n%s", map);
     }
-}
-
-// barrier wait
-void barrier_wait(pthread_barrier_t *bar) {
-    int returnVal = pthread_barrier_wait(bar);
-    if (!(returnVal != 0 || returnVal != PTHREAD_BARRIER_SERIAL_THREAD)) {
-        printf("ERROR: could not wait on the barrier\n");
+    // at most four frames in flight before stepping waits for the disk
+    if (frames_path != NULL && (frames = ca_frames_open(frames_path, engine, 4)) == NULL) {
         exit(EXIT_FAILURE);
     }
-}
-
-// destroy mutex
-void destroy(pthread_mutex_t *mut) {
-    if (pthread_mutex_destroy(mut) != 0) {
-        printf("ERROR: could not destroy the mutex\n");
+    START_TIMER(step);
+    ca_routine(engine, grid);
+    ca_engine_sync(engine);
+    if (frames != NULL && ca_frames_close(frames) != 0) {
         exit(EXIT_FAILURE);
     }
-}
+    STOP_TIMER(step);
+    STOP_TIMER(ca);
 
-// destroy barrier
-void destroy_barrier(pthread_barrier_t *bar) {
-    if (pthread_barrier_destroy(bar) != 0) {
-        printf("ERROR: could not destroy the barrier\n");
-        exit(EXIT_FAILURE);
-    }
-}
+    // print results, clean up, and exit
+    char desc[256];
+    ca_engine_describe(engine, desc, sizeof(desc));
+    printf("time for synchronous pthreads program: %4.4fs (%s)\n", GET_TIMER(ca), desc);
+    printf("init: %4.4fs, steps: %4.4fs\n", GET_TIMER(init), GET_TIMER(step));
+    ca_engine_profile(engine);
+    ca_engine_free(engine);
+    ca_grid_free(grid);
+    return (EXIT_SUCCESS);
 
+}
@@ -4,7 +4,7 @@
  *
  * Acknowledgements:
  * Game of Life transitions - https://natureofcode.com/book/chapter-7-cellular-automata/
- * 
+ *
  * Dr. Lam: file "timer.h", also used in p3 to calculate runtimes for specific code segments.
  *
  * Authors: Paul Bailey, Jenna Horrall, Callan Hand
@@ -12,177 +12,393 @@
  * ca_serial: Serial implementation of the synchronous ca model. The matrix
  * is updated serially and there is no randomization applied to this method.
  * Cellspace updates are stored in a temp array and updated at the end of
- * each timestep.
+ * each timestep. The model itself lives in libca; this program parses the
+ * options, runs the engine and reports the time.
+ *
+ * Kernels (-k):
+ *   int        one int per cell, transition evaluated per cell (default)
+ *   lut        3x3 neighborhood packed into an index into a 512 entry table
+ *   bitpacked  64 cells per uint64_t word, word-parallel step
+ *   simd       vectorized row kernel, best of avx512/avx2/sse2 for this CPU;
+ *              avx512, avx2, sse2 or scalar force one
+ *
+ * Rules (-r): B3/S23 (Game of Life, default), any other Life-like rule
+ * such as B36/S23, or a Generations rule such as B2/S/3. Rules other than
+ * B3/S23 run with the int kernel: common rules on a kernel specialized at
+ * compile time, the rest on a table.
+ *
+ * Temporal blocking (-T depth): bands of rows are advanced depth generations
+ * at a time while they are in cache. It helps the simd kernels on grids
+ * well beyond the last level cache; smaller grids are stepped without it.
+ *
+ * Activity tracking (-a tile): the grid is split into tile x tile blocks and
+ * only blocks that changed in the last timestep, or border one that did,
+ * are recomputed. The timing line reports the share of tiles skipped.
+ *
+ * Backend (-b): serial (default), or any other synchronous libca backend
+ * (pthreads, omp) with -n threads. -b hashlife advances by memoized
+ * quadtree squares instead, for runs of millions of timesteps; -M sets its
+ * cache budget in MB.
+ *
+ * Ensemble (-E members): up to 64 independent simulations in one run,
+ * member k starting from seed + k. Each cell is one 64 bit word holding
+ * that cell of every member, so one word-parallel step advances them all.
+ * -D lo[:hi] spreads the initial densities evenly from lo to hi across the
+ * members (default 0.5; at 0.5 member k starts exactly like a single run
+ * with --seed seed+k). -r and -n apply; the population of each member is
+ * printed after the timing line.
+ *
+ * Affinity (-P): pin the threads of -b pthreads/omp (the calling thread for
+ * the serial backends) to CPUs and bind the rows each one updates to the
+ * memory of its NUMA node. The placement map is printed at startup.
+ *   compact    fill the cores of one node before the next
+ *   scatter    deal the threads round-robin over the nodes
+ *   0,2,4-7    explicit CPU list, thread t on the t-th CPU
+ *
+ * Seed (--seed n): the initial cellspace depends only on the seed. Without
+ * --seed it is taken from the clock; the timing line reports it so a run
+ * can be repeated.
+ *
+ * Checkpoints (--checkpoint file): the state of the run is saved to file at
+ * the end and, with --checkpoint-every n, every n timesteps. --restart file
+ * continues a saved run up to <timesteps> in total, with the seed and rule
+ * it was started with; rows and cols have to match.
+ *
+ * Frames (--frames file): the cellspace is written to file every 10
+ * timesteps, or every n with --frames-every n, as a sequence of binary
+ * netpbm images: file.pbm one bit per cell, file.pgm one byte per cell
+ * (needed for Generations rules). A background thread encodes and writes
+ * them while the run goes on.
+ *
+ * Patterns (--pattern file): start from an RLE (.rle) or plaintext (.cells)
+ * Life pattern instead of a random cellspace, centered or with its top left
+ * cell at --pattern-at row,col. The rest of the cellspace starts dead; the
+ * rule comes from the RLE header unless -r is given.
  *
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <time.h>
 #include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
 
 #include "timer.h"
+#include "ca.h"
 
 int ROWS;
 int COLS;
 
-int MAX_ROWS;
-int MAX_COLS;
-
 int timesteps;
-bool debug = false;
 
-/*global matrix*/
-int *global_cells;
-int *next_transition;
+const char *checkpoint_path = NULL;
+int checkpoint_every = 0;
+const char *frames_path = NULL;
+int frames_every = 10;
+ca_frames_t *frames = NULL;
+int members = 0;
+double density_lo = 0.5;
+double density_hi = 0.5;
 
-void initialize();
-bool transition(int, int);
-void ca_routine();
-void print_cellspace(int*, int);
+void ca_routine(ca_engine_t*, ca_grid_t*);
+void ensemble_routine(const ca_config_t*);
+void usage();
 
 
 /*
- * Randomly generate a matrix of MAX_ROWS x MAX_COLS.
- * Each cell has two possible states: 0 (inactive) or 1 (active).
- * 
- *
+ * Perform the cellular automata transitions, up to timesteps in total.
  */
-void initialize() {
-
-    srand(time(0));
-    for (int x = 0; x < MAX_ROWS; x++) {
-        for (int y = 0; y < MAX_COLS; y++) {
-               // set to outer layer to all 1's to account for border cell transitions
-               if (x == ROWS+1 || x == 0 || y == 0 || y == COLS+1) {
-                   *(global_cells + x*(COLS+2) + y) = 1;
-               } else {
-                   *(global_cells + x*(COLS+2) + y) = (rand() % (11 - 10 + 1) + 10) - 10;  
-               }
+void ca_routine(ca_engine_t *engine, ca_grid_t *grid) {
+
+    int time = ca_engine_timestep(engine);
+    int next_checkpoint = time + checkpoint_every;
+
+    while (1) {
+        // frames are written in the background while the run goes on
+        if (frames != NULL && time % frames_every == 0) {
+            ca_engine_sync(engine);
+            if (ca_frames_write(frames, grid, time) != 0) {
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (time >= timesteps) {
+            break;
+        }
+
+        // step to the next frame or checkpoint, whichever comes first
+        int end = timesteps;
+        if (checkpoint_every > 0 && next_checkpoint < end) {
+            end = next_checkpoint;
+        }
+        if (frames != NULL && (time / frames_every + 1) * frames_every < end) {
+            end = (time / frames_every + 1) * frames_every;
+        }
+        ca_engine_step(engine, end - time);
+        time = end;
+
+        if (time == timesteps || (checkpoint_every > 0 && time == next_checkpoint)) {
+            if (checkpoint_path != NULL && ca_engine_checkpoint(engine, checkpoint_path) != 0) {
+                exit(EXIT_FAILURE);
+            }
+            next_checkpoint = time + checkpoint_every;
         }
     }
 
 }
 
 
+
 /*
- * Returns true if a cell (x,y) in the cells matrix would survive to the next transition.
- *     Doesn't currently adjust any border cells.
- *
+ * Run the ensemble and print each member's population.
  */
-bool transition(int x, int y) {
-
-	int livingNeighbors = 0;
+void ensemble_routine(const ca_config_t *config) {
 
-	for (int nRows = x - 1; nRows <= x + 1; nRows++) {     //Count Living Neighbors
-	    for (int nCols = y - 1; nCols <= y + 1; nCols++) {
-		if (*(global_cells + nRows*MAX_COLS + nCols) == 1) { 
-		    livingNeighbors++;
-		}
-	    }
-	}
-
-        //subtract current cell
-        livingNeighbors -=  *(global_cells + x*(MAX_COLS) + y);
-
-	if (*(global_cells + x*MAX_COLS + y) == 1) {           //Decide if cell will live or perish
-	    return (livingNeighbors == 2 || livingNeighbors == 3);
-	} else {
-	    return (livingNeighbors == 3);
-	}
-
-}
-
-/*
- * Perform the cellular automata transitions.
- */ 
-void ca_routine() {
-
-    int time = 0;
-    while (time < timesteps) {
- 
-       for (int i = 1; i < MAX_ROWS-1; i++) {
-           for (int j = 1; j < MAX_COLS-1; j++) {
-               // if cell can move, perform transition else keep previous value
-               if (transition(i,j)) {
-                   *(next_transition + i*(MAX_COLS) + j) = 1;
-               } else {
-                   *(next_transition + i*(MAX_COLS) + j) = 0;
-               }
-           }
-       }
-
-       global_cells = next_transition;
-
-       // print cellspace every 10 timesteps.
-       if (time % 10 == 0 && debug) {
-           print_cellspace(global_cells, time);
-       }
-
-       time++;
+    START_TIMER(ca);
+    START_TIMER(init);
+    ca_ensemble_t *ensemble = ca_ensemble_create(ROWS, COLS, members, config);
+    if (ensemble == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    double *density = (double*) malloc(members * sizeof(double));
+    for (int k = 0; k < members; k++) {
+        density[k] = members > 1 ? density_lo + (density_hi - density_lo) * k / (members - 1)
+                                 : density_lo;
+        ca_ensemble_randomize(ensemble, k, config->seed + k, density[k]);
+    }
+    STOP_TIMER(init);
+    START_TIMER(step);
+    ca_ensemble_step(ensemble, timesteps);
+    STOP_TIMER(step);
+    STOP_TIMER(ca);
 
+    long long population[CA_ENSEMBLE_MAX];
+    ca_ensemble_population(ensemble, population);
+    printf("time for synchronous serial ensemble: %4.4fs (members: %d, rule: %s, threads: %d, seed: %llu)\n",
+           GET_TIMER(ca), members, config->rule != NULL ? config->rule : "B3/S23",
+           config->threads, (unsigned long long)config->seed);
+    printf("init: %4.4fs, steps: %4.4fs\n", GET_TIMER(init), GET_TIMER(step));
+    for (int k = 0; k < members; k++) {
+        printf("member %d: seed %llu, density %.4f, population %lld\n", k,
+               (unsigned long long)(config->seed + k), density[k], population[k]);
     }
+    free(density);
+    ca_ensemble_free(ensemble);
 
 }
 
 
 
-
 /*
- * Print the cellspace.
- *
- * Notice the for loop is from [1, maxrows-1]:
- * this is because of the ghost border.
+ * Print usage and exit.
  */
-void print_cellspace(int* p, int timestep) {
+void usage() {
 
-    for (int x = 1; x < MAX_ROWS-1; x++) {
-        for (int y = 1; y < MAX_COLS-1; y++) {
-            printf(" %d ", *(p + x*(MAX_COLS) + y)) ;
-       }
-    printf("\n");
-    }
-    printf("\n");
+    printf("Usage: ./ca_serial [--seed n] [--checkpoint file [--checkpoint-every n]] [--restart file] [--pattern file [--pattern-at row,col]] [--frames file [--frames-every n]] [-k int|lut|bitpacked|simd] [-r rule] [-a tile] [-T depth] [-b backend] [-n threads] [-M cache_mb] [-P compact|scatter|cpus] [-E members [-D lo[:hi]]] <rows> <cols> <timesteps> \n");
+    exit(EXIT_FAILURE);
 
 }
 
 
-
 /*
  * Main routine.
  */
 int main(int argc, char* argv[])
 {
+    ca_config_t config;
+    ca_config_default(&config);
+    const char *backend = "serial";
+
     // check and parse command line options
-    if (argc != 4) {
-        printf("Usage: ./ca_serial <rows> <cols> <timesteps> \n");
-        exit(EXIT_FAILURE);
+    static const struct option long_options[] = {
+        {"seed", required_argument, NULL, 'S'},
+        {"checkpoint", required_argument, NULL, 'C'},
+        {"checkpoint-every", required_argument, NULL, 'I'},
+        {"restart", required_argument, NULL, 'R'},
+        {"pattern", required_argument, NULL, 'L'},
+        {"pattern-at", required_argument, NULL, 'O'},
+        {"frames", required_argument, NULL, 'F'},
+        {"frames-every", required_argument, NULL, 'J'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "k:T:b:n:a:M:r:E:D:P:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'k':
+            config.kernel = optarg;
+            break;
+        case 'S': {
+            char *end;
+            config.seed = strtoull(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0') {
+                printf("ERROR: seed must be a non-negative integer\n");
+                usage();
+            }
+            break;
+        }
+        case 'r':
+            config.rule = optarg;
+            break;
+        case 'C':
+            checkpoint_path = optarg;
+            break;
+        case 'I':
+            checkpoint_every = atoi(optarg);
+            if (checkpoint_every < 1) {
+                printf("ERROR: checkpoint interval must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'R':
+            config.restart = optarg;
+            break;
+        case 'L':
+            config.pattern = optarg;
+            break;
+        case 'O': {
+            char end;
+            if (sscanf(optarg, "%d,%d%c", &config.pattern_row, &config.pattern_col, &end) != 2
+                    || config.pattern_row < 0 || config.pattern_col < 0) {
+                printf("ERROR: pattern position must be row,col with non-negative integers\n");
+                usage();
+            }
+            break;
+        }
+        case 'F':
+            frames_path = optarg;
+            break;
+        case 'J':
+            frames_every = atoi(optarg);
+            if (frames_every < 1) {
+                printf("ERROR: frame interval must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'T':
+            config.block_depth = atoi(optarg);
+            if (config.block_depth < 1) {
+                printf("ERROR: temporal block depth must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'b':
+            backend = optarg;
+            break;
+        case 'n':
+            config.threads = atoi(optarg);
+            if (config.threads < 1) {
+                printf("ERROR: thread_count must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'P':
+            config.affinity = optarg;
+            break;
+        case 'a':
+            config.tile_size = atoi(optarg);
+            if (config.tile_size < 1) {
+                printf("ERROR: tile size must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'M':
+            config.cache_mb = atoi(optarg);
+            if (config.cache_mb < 1) {
+                printf("ERROR: cache budget must be greater than 0\n");
+                usage();
+            }
+            break;
+        case 'E':
+            members = atoi(optarg);
+            if (members < 1 || members > CA_ENSEMBLE_MAX) {
+                printf("ERROR: an ensemble has 1 to %d members\n", CA_ENSEMBLE_MAX);
+                usage();
+            }
+            break;
+        case 'D': {
+            char *end;
+            density_lo = strtod(optarg, &end);
+            density_hi = density_lo;
+            if (*end == ':') {
+                density_hi = strtod(end + 1, &end);
+            }
+            if (*end != '\0' || density_lo < 0.0 || density_lo > 1.0
+                    || density_hi < 0.0 || density_hi > 1.0) {
+                printf("ERROR: densities must be between 0 and 1\n");
+                usage();
+            }
+            break;
+        }
+        default:
+            usage();
+        }
     }
-   
-    ROWS = atoi(argv[1]);
-    COLS = atoi(argv[2]);
-    timesteps = atoi(argv[3]);
+    if (argc - optind != 3) {
+        usage();
+    }
+
+    ROWS = atoi(argv[optind]);
+    COLS = atoi(argv[optind+1]);
+    timesteps = atoi(argv[optind+2]);
 
     if (ROWS < 0 || COLS < 0) {
         printf("ERROR: please enter a positive number for rows and cols.\n");
         exit(EXIT_FAILURE);
     }
 
-    /* set max rows/cols for ghost border */
-    MAX_ROWS=ROWS+2;
-    MAX_COLS=COLS+2;
+    if (members > 0) {
+        if (checkpoint_path != NULL || config.restart != NULL) {
+            printf("ERROR: ensembles can't be checkpointed\n");
+            usage();
+        }
+        if (frames_path != NULL) {
+            printf("ERROR: ensembles don't write frames\n");
+            usage();
+        }
+        if (config.pattern != NULL) {
+            printf("ERROR: ensemble members start from random cellspaces\n");
+            usage();
+        }
+        ensemble_routine(&config);
+        return (EXIT_SUCCESS);
+    }
 
-    global_cells = (int*) calloc((MAX_ROWS * MAX_COLS), sizeof(int));
-    next_transition = (int*) calloc((MAX_ROWS * MAX_COLS), sizeof(int));
+    // ca_engine_create fills the grid, on the backend's threads if it has any
+    ca_grid_t *grid = ca_grid_alloc(ROWS, COLS);
+    config.randomize = true;
 
     START_TIMER(ca);
-    initialize();
-    ca_routine();
+    START_TIMER(init);
+    ca_engine_t *engine = ca_engine_create(backend, grid, &config);
+    if (engine == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    STOP_TIMER(init);
+    if (config.affinity != NULL) {
+        char map[8192];
+        ca_engine_placement(engine, map, sizeof(map));
+        printf("placement:\n%s", map);
+    }
+    // at most four frames in flight before stepping waits for the disk
+    if (frames_path != NULL && (frames = ca_frames_open(frames_path, engine, 4)) == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    START_TIMER(step);
+    ca_routine(engine, grid);
+    ca_engine_sync(engine);
+    if (frames != NULL && ca_frames_close(frames) != 0) {
+        exit(EXIT_FAILURE);
+    }
+    STOP_TIMER(step);
     STOP_TIMER(ca);
 
-    printf("time for synchronous serial program: %4.4fs\n", GET_TIMER(ca));
-    free(global_cells);
+    char desc[256];
+    ca_engine_describe(engine, desc, sizeof(desc));
+    printf("time for synchronous serial program: %4.4fs (%s)\n", GET_TIMER(ca), desc);
+    printf("init: %4.4fs, steps: %4.4fs\n", GET_TIMER(init), GET_TIMER(step));
+    ca_engine_profile(engine);
+    ca_engine_free(engine);
+    ca_grid_free(grid);
     return (EXIT_SUCCESS);
 }
-
@@ -0,0 +1,377 @@
+/*
+ * affinity.c
+ *
+ * Thread placement, see affinity.h. The topology comes from sysfs
+ * (/sys/devices/system/{cpu,node}); without it every CPU counts as one
+ * core on node 0. Pages are bound with the mbind system call directly, so
+ * libca doesn't need libnuma.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "affinity.h"
+
+/* mbind mode from <numaif.h> */
+#define AFFINITY_MPOL_PREFERRED 1
+/* nodes an mbind mask can name */
+#define AFFINITY_MAX_NODES 1024
+
+typedef struct {
+    int cpu;
+    int node;
+    int package;
+    int core;
+    int smt;        /* position among the hyperthreads of its core */
+} cpu_info_t;
+
+
+/*
+ * First integer in a sysfs file, or fallback if it can't be read.
+ */
+static int read_int(const char *path, int fallback) {
+
+    FILE *f = fopen(path, "r");
+    int value;
+    if (f == NULL) {
+        return fallback;
+    }
+    if (fscanf(f, "%d", &value) != 1) {
+        value = fallback;
+    }
+    fclose(f);
+    return value;
+
+}
+
+
+/*
+ * Parse a CPU list such as "0,2,4-7" into out, in the order given. Returns
+ * the number of CPUs, or -1 if the list is malformed or longer than max.
+ */
+static int parse_list(const char *s, int *out, int max) {
+
+    int n = 0;
+    while (*s != '\0' && *s != '\n') {
+        if (!isdigit((unsigned char)*s)) {
+            return -1;
+        }
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (*end == '-') {
+            if (!isdigit((unsigned char)end[1])) {
+                return -1;
+            }
+            hi = strtol(end + 1, &end, 10);
+        }
+        if (hi < lo || hi >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long c = lo; c <= hi; c++) {
+            if (n == max) {
+                return -1;
+            }
+            out[n++] = (int)c;
+        }
+        if (*end == ',') {
+            end++;
+            if (*end == '\0') {
+                return -1;
+            }
+        } else if (*end != '\0' && *end != '\n') {
+            return -1;
+        }
+        s = end;
+    }
+    return n;
+
+}
+
+
+/*
+ * Fill node_of[cpu] from /sys/devices/system/node. Returns the node count.
+ */
+static int read_nodes(int *node_of) {
+
+    int nodes = 1;
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir == NULL) {
+        return nodes;
+    }
+    struct dirent *entry;
+    int *list = (int*) malloc(CPU_SETSIZE * sizeof(int));
+    while ((entry = readdir(dir)) != NULL) {
+        int node;
+        char path[300], text[4096];
+        if (sscanf(entry->d_name, "node%d", &node) != 1 || node < 0
+                || node >= AFFINITY_MAX_NODES) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", entry->d_name);
+        FILE *f = fopen(path, "r");
+        if (f == NULL) {
+            continue;
+        }
+        int count = fgets(text, sizeof(text), f) != NULL ? parse_list(text, list, CPU_SETSIZE) : -1;
+        fclose(f);
+        for (int i = 0; i < count; i++) {
+            node_of[list[i]] = node;
+        }
+        if (node + 1 > nodes) {
+            nodes = node + 1;
+        }
+    }
+    free(list);
+    closedir(dir);
+    return nodes;
+
+}
+
+
+static void read_cpu(cpu_info_t *info, int cpu, const int *node_of) {
+
+    char path[128], text[256];
+    int siblings[64];
+
+    info->cpu = cpu;
+    info->node = node_of[cpu];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    info->package = read_int(path, 0);
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+    info->core = read_int(path, cpu);
+
+    info->smt = 0;
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return;
+    }
+    int count = fgets(text, sizeof(text), f) != NULL ? parse_list(text, siblings, 64) : -1;
+    fclose(f);
+    for (int i = 0; i < count; i++) {
+        if (siblings[i] == cpu) {
+            info->smt = i;
+        }
+    }
+
+}
+
+
+/* compact: node, then core, hyperthreads of a core adjacent */
+static int by_core(const void *a, const void *b) {
+
+    const cpu_info_t *x = (const cpu_info_t*) a, *y = (const cpu_info_t*) b;
+    if (x->node != y->node) return x->node - y->node;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    if (x->smt != y->smt) return x->smt - y->smt;
+    return x->cpu - y->cpu;
+
+}
+
+
+/* scatter: node, then the first hyperthread of every core before the second */
+static int by_smt(const void *a, const void *b) {
+
+    const cpu_info_t *x = (const cpu_info_t*) a, *y = (const cpu_info_t*) b;
+    if (x->node != y->node) return x->node - y->node;
+    if (x->smt != y->smt) return x->smt - y->smt;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+
+}
+
+
+/*
+ * Place threads threads on CPUs by policy, thread t in slot first + t.
+ * Returns -1 (after printing why) for an unknown policy or a CPU outside
+ * the process's affinity mask.
+ */
+int affinity_init(affinity_t *a, const char *policy, int threads, int first) {
+
+    memset(a, 0, sizeof(affinity_t));
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        printf("ERROR: could not read the CPU affinity mask\n");
+        return -1;
+    }
+    int *node_of = (int*) calloc(CPU_SETSIZE, sizeof(int));
+    int nodes = read_nodes(node_of);
+    cpu_info_t *cpus = (cpu_info_t*) malloc(CPU_SETSIZE * sizeof(cpu_info_t));
+    int n = 0;
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (CPU_ISSET(c, &allowed)) {
+            read_cpu(&cpus[n++], c, node_of);
+        }
+    }
+
+    a->policy = policy;
+    a->threads = threads;
+    a->nodes = nodes;
+    a->cpu = (int*) malloc(threads * sizeof(int));
+    a->node = (int*) malloc(threads * sizeof(int));
+
+    int err = 0;
+    if (strcmp(policy, "compact") == 0) {
+        qsort(cpus, n, sizeof(cpu_info_t), by_core);
+        for (int t = 0; t < threads; t++) {
+            a->cpu[t] = cpus[(first + t) % n].cpu;
+        }
+    } else if (strcmp(policy, "scatter") == 0) {
+        // cpus[start[k], start[k] + count[k]) are the CPUs of the k-th node used
+        qsort(cpus, n, sizeof(cpu_info_t), by_smt);
+        int *start = (int*) malloc(n * sizeof(int));
+        int *count = (int*) calloc(n, sizeof(int));
+        int used = 0;
+        for (int i = 0; i < n; i++) {
+            if (i == 0 || cpus[i].node != cpus[i-1].node) {
+                start[used++] = i;
+            }
+            count[used-1]++;
+        }
+        for (int t = 0; t < threads; t++) {
+            int s = first + t;
+            int k = s % used;
+            a->cpu[t] = cpus[start[k] + (s / used) % count[k]].cpu;
+        }
+        free(start);
+        free(count);
+    } else {
+        int *list = (int*) malloc(CPU_SETSIZE * sizeof(int));
+        int len = parse_list(policy, list, CPU_SETSIZE);
+        if (len <= 0) {
+            printf("ERROR: unknown affinity '%s', expected compact, scatter or a CPU list such as 0,2,4-7\n",
+                   policy);
+            err = -1;
+        }
+        for (int i = 0; i < len && err == 0; i++) {
+            if (!CPU_ISSET(list[i], &allowed)) {
+                printf("ERROR: CPU %d is not available to this process\n", list[i]);
+                err = -1;
+            }
+        }
+        for (int t = 0; t < threads && err == 0; t++) {
+            a->cpu[t] = list[(first + t) % len];
+        }
+        free(list);
+    }
+
+    if (err == 0) {
+        for (int t = 0; t < threads; t++) {
+            a->node[t] = node_of[a->cpu[t]];
+        }
+    } else {
+        affinity_free(a);
+    }
+    free(cpus);
+    free(node_of);
+    return err;
+
+}
+
+
+/*
+ * Pin the calling thread as thread rank. Thread 0 has to be the thread that
+ * created the engine; its previous mask is restored by affinity_free().
+ */
+void affinity_pin(affinity_t *a, int rank) {
+
+    if (a->threads == 0) {
+        return;
+    }
+    if (rank == 0 && a->caller_mask == NULL) {
+        a->caller_mask = malloc(sizeof(cpu_set_t));
+        pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), (cpu_set_t*) a->caller_mask);
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(a->cpu[rank % a->threads], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+}
+
+
+/*
+ * Prefer the node of thread rank's CPU for the whole pages in [addr,
+ * addr + bytes). Only affects pages not yet touched; a no-op on one node or
+ * where mbind isn't permitted.
+ */
+void affinity_bind(const affinity_t *a, int rank, void *addr, size_t bytes) {
+
+#ifdef __linux__
+    if (a->threads == 0 || a->nodes < 2 || bytes == 0) {
+        return;
+    }
+    int node = a->node[rank % a->threads];
+    if (node >= AFFINITY_MAX_NODES) {
+        return;
+    }
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t begin = ((uintptr_t)addr + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t)addr + bytes) & ~(page - 1);
+    if (end <= begin) {
+        return;
+    }
+    unsigned long mask[AFFINITY_MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    // the kernel reads maxnode - 1 bits
+    syscall(SYS_mbind, (void*)begin, (unsigned long)(end - begin), AFFINITY_MPOL_PREFERRED,
+            mask, (unsigned long)AFFINITY_MAX_NODES + 1, 0);
+#else
+    (void)a;
+    (void)rank;
+    (void)addr;
+    (void)bytes;
+#endif
+
+}
+
+
+/*
+ * One line per thread: "thread 0: cpu 0, node 0".
+ */
+void affinity_map(const affinity_t *a, char *buf, size_t len) {
+
+    size_t n = 0;
+    if (len == 0) {
+        return;
+    }
+    buf[0] = '\0';
+    for (int t = 0; t < a->threads && n + 1 < len; t++) {
+        snprintf(buf + n, len - n, "thread %d: cpu %d, node %d\n", t, a->cpu[t], a->node[t]);
+        n += strlen(buf + n);
+    }
+
+}
+
+
+void affinity_free(affinity_t *a) {
+
+    if (a->caller_mask != NULL) {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), (cpu_set_t*) a->caller_mask);
+        free(a->caller_mask);
+    }
+    free(a->cpu);
+    free(a->node);
+    memset(a, 0, sizeof(affinity_t));
+
+}
@@ -0,0 +1,46 @@
+/*
+ * affinity.h
+ *
+ * Placement of the worker threads (config.affinity). A policy maps thread
+ * slots to CPUs:
+ *
+ *   compact   fill one NUMA node before the next, hyperthreads of a core
+ *             next to each other
+ *   scatter   deal the slots round-robin over the NUMA nodes, one per
+ *             physical core before any core gets a second one
+ *   0,2,4-7   explicit CPU list, slot s on the s-th CPU of the list
+ *
+ * Only CPUs in the process's affinity mask (taskset, mpirun --bind-to) are
+ * used, and slots wrap around when there are more threads than CPUs. Slots
+ * are numbered per machine: MPI ranks sharing a node start at local rank *
+ * threads per rank, so their threads get disjoint CPUs.
+ *
+ * affinity_bind() asks the kernel to place the pages of a buffer on the
+ * node of a thread's CPU (mbind, MPOL_PREFERRED) before they are first
+ * touched, so a band of rows lands on its thread's node whichever thread
+ * writes it first.
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    const char *policy;
+    int threads;            /* 0 = not pinned */
+    int *cpu;               /* CPU of each thread */
+    int *node;              /* NUMA node of that CPU */
+    int nodes;              /* NUMA nodes in the machine */
+    void *caller_mask;      /* cpu_set_t of the calling thread before it was
+                               pinned as thread 0, NULL if it wasn't */
+} affinity_t;
+
+int affinity_init(affinity_t *a, const char *policy, int threads, int first);
+void affinity_pin(affinity_t *a, int rank);
+void affinity_bind(const affinity_t *a, int rank, void *addr, size_t bytes);
+void affinity_map(const affinity_t *a, char *buf, size_t len);
+void affinity_free(affinity_t *a);
+
+#endif
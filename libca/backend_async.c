@@ -0,0 +1,476 @@
+/*
+ * backend_async.c
+ *
+ * Asynchronous (randomized) backends. Cells are updated in place, so every
+ * update sees the ones made before it.
+ *
+ *   rand_ind             random independent scheme: one cell chosen at random
+ *                        is updated each timestep.
+ *   rand_ind_pthreads    random independent scheme on a persistent pool of
+ *                        worker threads, alternating strips of rows.
+ *   rand_order           random order scheme: every cell is updated once per
+ *                        timestep, in a random permutation drawn afresh for
+ *                        each timestep.
+ *   rand_order_pthreads  random order scheme on a persistent pool of worker
+ *                        threads, one 2x2 sublattice at a time.
+ *
+ * rand_order_pthreads colors cell (r,c) by the parity of r and of c. Two
+ * cells of the same color are at least two rows or two columns apart, so
+ * neither is in the other's neighborhood: the cells of one color can be
+ * updated in place concurrently without locks, and the result doesn't
+ * depend on the order they are updated in. Each timestep visits the four
+ * colors in a random order, so the model is block-sequential: random order
+ * across colors, any order within one. The color orders are drawn from
+ * engine->prng on the calling thread before the workers are released, so
+ * they don't depend on the thread count; the threads split each color's
+ * rows and meet at a barrier between colors.
+ *
+ * rand_ind_pthreads runs the updates in batches of about IND_BATCH per strip
+ * of IND_STRIP rows. The cells of a batch are drawn uniformly over the grid
+ * from a stream seeded by prng_hash() of the batch number, so every cell is
+ * hit with probability 1/(rows*cols) per update whatever the thread count.
+ * The threads draw the cells of IND_BLOCK batches at a time, a batch each;
+ * then, batch by batch, they apply the updates
+ * that fall in even strips, in update order within each strip, meet at a
+ * barrier, and do the same for the odd strips. Two strips of the same
+ * parity are at least one strip apart, so none of them reads a cell another
+ * is writing. Only the order inside a batch is coarser than rand_ind's: any
+ * prefix of the run is uniform over the grid but for the batch it ends in,
+ * which is at most IND_BATCH/2 updates per strip ahead on the even strips.
+ *
+ * engine->counter counts the updates done over the whole run, in the order
+ * they are applied (a batch's even strips, then its odd strips). A step
+ * applies the updates from counter on, so a batch cut by the end of a step
+ * is finished by the next one and the result does not depend on how a run
+ * is split into ca_engine_step() calls either.
+ *
+ * All random draws come from engine->prng (prng.h), seeded by config.seed.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "ca_internal.h"
+#include "pool.h"
+
+#define COLORS 4
+#define IND_STRIP 8             /* rows per strip */
+#define IND_BATCH 8             /* updates per strip in a batch, on average */
+#define IND_BLOCK 16            /* batches drawn at a time */
+
+typedef struct {
+    ca_engine_t *engine;
+    uint32_t *perm;         /* padded offsets of the cells, in update order */
+    size_t cells;
+} order_t;
+
+
+/*
+ * Update cell (r,c) of the grid in place.
+ */
+static inline void update_cell(const ca_engine_t *engine, ca_grid_t *grid, int r, int c) {
+
+    *(grid->cells + r*grid->max_cols + c) =
+        engine->transition(&engine->rule, grid->cells, grid->max_cols, r, c);
+
+}
+
+
+/* ================= random independent ================= */
+
+static int ind_init(ca_engine_t *engine) {
+
+    (void)engine;
+    return 0;
+
+}
+
+
+static void ind_step(ca_engine_t *engine, int generations) {
+
+    ca_grid_t *grid = engine->grid;
+
+    for (int t = 0; t < generations; t++) {
+        int r = prng_below(&engine->prng, grid->rows) + 1;
+        int c = prng_below(&engine->prng, grid->cols) + 1;
+        update_cell(engine, grid, r, c);
+    }
+
+}
+
+
+const ca_backend_t ca_backend_rand_ind = {
+    .name = "rand_ind",
+    .kernels = CA_KERNEL_INT,
+    .random = true,
+    .init = ind_init,
+    .step = ind_step,
+};
+
+
+/* ================= random independent, pthreads ================= */
+
+typedef struct {
+    int row, col;
+} ind_update_t;
+
+typedef struct {
+    ca_engine_t *engine;
+    pool_t *pool;
+    int generations;        /* work for the current step */
+    int strips;
+    uint64_t batch_size;
+    ind_update_t *block;    /* cells of the current block of batches, in update order */
+} strips_t;
+
+
+static int strips_init(ca_engine_t *engine) {
+
+    ca_grid_t *grid = engine->grid;
+    if ((uint64_t)grid->rows * grid->cols > UINT32_MAX) {
+        printf("ERROR: grid too large for the random independent scheme\n");
+        return -1;
+    }
+
+    strips_t *strips = (strips_t*) calloc(1, sizeof(strips_t));
+    strips->engine = engine;
+    strips->strips = (grid->rows + IND_STRIP - 1) / IND_STRIP;
+    strips->batch_size = (uint64_t)IND_BATCH * strips->strips;
+    strips->block = (ind_update_t*) malloc((strips->batch_size > 0 ? strips->batch_size : 1)
+                                           * IND_BLOCK * sizeof(ind_update_t));
+    strips->pool = pool_create(engine->config.threads, engine->config.spin_barrier,
+                               engine->profile);
+    if (strips->pool == NULL) {
+        free(strips->block);
+        free(strips);
+        return -1;
+    }
+    ca_engine_affinity(engine, strips->pool->threads, 0);
+    pool_pin(strips->pool, &engine->affinity);
+    engine->state = strips;
+    return 0;
+
+}
+
+
+/*
+ * Apply this thread's strips' part of the updates [engine->counter,
+ * engine->counter + generations), batch by batch.
+ */
+static void strips_run(pool_t *pool, int rank, void *arg) {
+
+    strips_t *strips = (strips_t*) arg;
+    ca_engine_t *engine = strips->engine;
+    ca_grid_t *grid = engine->grid;
+    // read once: rank 0 may post the next step while others finish this one
+    const uint64_t step_first = engine->counter;
+    const uint64_t step_end = step_first + (uint64_t)strips->generations;
+    const uint64_t batch_size = strips->batch_size;
+    const uint64_t block_size = batch_size * IND_BLOCK;
+
+    for (uint64_t k = step_first / block_size; k * block_size < step_end; k++) {
+        // the threads draw the block's batches, each from its own stream
+        ind_update_t *block = strips->block;
+        for (int b = rank; b < IND_BLOCK; b += pool->threads) {
+            prng_t prng;
+            prng_seed(&prng, prng_hash(engine->config.seed, PRNG_STREAM_IND,
+                                       k * IND_BLOCK + b), 0);
+            for (uint64_t u = b * batch_size; u < (b + 1) * batch_size; u++) {
+                block[u].row = prng_below(&prng, grid->rows) + 1;
+                block[u].col = prng_below(&prng, grid->cols) + 1;
+            }
+        }
+        pool_barrier(pool, rank);
+
+        for (int b = 0; b < IND_BLOCK; b++) {
+            const uint64_t base = k * block_size + b * batch_size;
+            if (base + batch_size <= step_first || base >= step_end) {
+                continue;
+            }
+            // the step's updates in this batch, numbered in the order they are applied
+            const uint64_t lo = step_first > base ? step_first - base : 0;
+            const uint64_t hi = step_end - base < batch_size ? step_end - base : batch_size;
+            const ind_update_t *batch = block + b * batch_size;
+
+            uint64_t applied = 0;   // updates of the batch before this one, all threads'
+            for (int parity = 0; parity < 2; parity++) {
+                // strips parity, parity+2, ... split among the threads
+                int n = (strips->strips - parity + 1) / 2;
+                int share = n / pool->threads;
+                int extra = n % pool->threads;
+                int start = rank*share + (rank < extra ? rank : extra);
+                int end = start + share + (rank < extra ? 1 : 0);
+
+                for (uint64_t u = 0; u < batch_size; u++) {
+                    int strip = (batch[u].row - 1) / IND_STRIP;
+                    if ((strip & 1) != parity) {
+                        continue;
+                    }
+                    uint64_t i = applied++;
+                    if (i < lo || i >= hi || strip / 2 < start || strip / 2 >= end) {
+                        continue;
+                    }
+                    update_cell(engine, grid, batch[u].row, batch[u].col);
+                }
+                pool_barrier(pool, rank);
+            }
+        }
+    }
+
+}
+
+
+static void strips_step(ca_engine_t *engine, int generations) {
+
+    strips_t *strips = (strips_t*) engine->state;
+    ca_grid_t *grid = engine->grid;
+    uint64_t cells = (uint64_t)grid->rows * grid->cols;
+    if (cells == 0 || generations <= 0) {
+        return;
+    }
+
+    strips->generations = generations;
+    pool_run(strips->pool, strips_run, strips);
+    engine->counter += (uint64_t)generations;
+
+}
+
+
+static void strips_describe(ca_engine_t *engine, char *buf, size_t len) {
+
+    strips_t *strips = (strips_t*) engine->state;
+    snprintf(buf, len, ", threads: %d, strips: %d", strips->pool->threads, strips->strips);
+
+}
+
+
+static void strips_fini(ca_engine_t *engine) {
+
+    strips_t *strips = (strips_t*) engine->state;
+    pool_free(strips->pool);
+    free(strips->block);
+    free(strips);
+
+}
+
+
+const ca_backend_t ca_backend_rand_ind_pthreads = {
+    .name = "rand_ind_pthreads",
+    .kernels = CA_KERNEL_INT,
+    .random = true,
+    .init = strips_init,
+    .step = strips_step,
+    .describe = strips_describe,
+    .fini = strips_fini,
+};
+
+
+/* ================= random order ================= */
+
+static int order_init(ca_engine_t *engine) {
+
+    ca_grid_t *grid = engine->grid;
+    if ((size_t)grid->max_rows * grid->max_cols > UINT32_MAX) {
+        printf("ERROR: grid too large for the random order scheme\n");
+        return -1;
+    }
+
+    order_t *order = (order_t*) calloc(1, sizeof(order_t));
+    order->engine = engine;
+    order->cells = (size_t)grid->rows * grid->cols;
+    order->perm = (uint32_t*) malloc((order->cells > 0 ? order->cells : 1) * sizeof(uint32_t));
+    if (order->perm == NULL) {
+        printf("ERROR: could not allocate the update order\n");
+        free(order);
+        return -1;
+    }
+
+    engine->state = order;
+    return 0;
+
+}
+
+
+/*
+ * Draw a permutation of the cell offsets (inside-out Fisher-Yates) and
+ * update every cell once in that order, so a sweep is exactly rows*cols
+ * updates. Each permutation is built from scratch rather than by shuffling
+ * the previous one, so the state of a run is just the grid and
+ * engine->prng, which is what a checkpoint saves.
+ */
+static void order_step(ca_engine_t *engine, int generations) {
+
+    ca_grid_t *grid = engine->grid;
+    order_t *order = (order_t*) engine->state;
+    uint32_t *perm = order->perm;
+    size_t n = order->cells;
+
+    for (int t = 0; t < generations; t++) {
+        // cell i is (r, c), walked along with i
+        int r = 1, c = 1;
+        for (size_t i = 0; i < n; i++) {
+            size_t j = prng_below(&engine->prng, (uint32_t)(i + 1));
+            if (j != i) {
+                perm[i] = perm[j];
+            }
+            perm[j] = (uint32_t)(r*grid->max_cols + c);
+            if (++c > grid->cols) {
+                c = 1;
+                r++;
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            update_cell(engine, grid, perm[i] / grid->max_cols, perm[i] % grid->max_cols);
+        }
+    }
+
+}
+
+
+static void order_fini(ca_engine_t *engine) {
+
+    order_t *order = (order_t*) engine->state;
+    free(order->perm);
+    free(order);
+
+}
+
+
+const ca_backend_t ca_backend_rand_order = {
+    .name = "rand_order",
+    .kernels = CA_KERNEL_INT,
+    .random = true,
+    .init = order_init,
+    .step = order_step,
+    .fini = order_fini,
+};
+
+
+/* ================= random order, pthreads ================= */
+
+typedef struct {
+    ca_engine_t *engine;
+    pool_t *pool;
+    int generations;        /* work for the current step */
+    unsigned char *orders;  /* COLORS colors per timestep, in update order */
+    int capacity;           /* timesteps orders has room for */
+} colored_t;
+
+
+static int colored_init(ca_engine_t *engine) {
+
+    colored_t *colored = (colored_t*) calloc(1, sizeof(colored_t));
+    colored->engine = engine;
+    colored->pool = pool_create(engine->config.threads, engine->config.spin_barrier,
+                                engine->profile);
+    if (colored->pool == NULL) {
+        free(colored);
+        return -1;
+    }
+    ca_engine_affinity(engine, colored->pool->threads, 0);
+    pool_pin(colored->pool, &engine->affinity);
+    engine->state = colored;
+    return 0;
+
+}
+
+
+/*
+ * Update this thread's share of the cells of each color in turn, for
+ * colored->generations timesteps.
+ */
+static void colored_run(pool_t *pool, int rank, void *arg) {
+
+    colored_t *colored = (colored_t*) arg;
+    ca_engine_t *engine = colored->engine;
+    ca_grid_t *grid = engine->grid;
+    // read once: rank 0 may post the next step while others finish this one
+    int generations = colored->generations;
+    const unsigned char *orders = colored->orders;
+
+    for (int t = 0; t < generations; t++) {
+        for (int k = 0; k < COLORS; k++) {
+            int color = orders[t*COLORS + k];
+            int row_parity = color >> 1;
+            int col_parity = color & 1;
+
+            // rows 1+row_parity, 3+row_parity, ... split among the threads
+            int n = (grid->rows - row_parity + 1) / 2;
+            int base = n / pool->threads;
+            int extra = n % pool->threads;
+            int start = rank*base + (rank < extra ? rank : extra);
+            int end = start + base + (rank < extra ? 1 : 0);
+
+            for (int i = start; i < end; i++) {
+                int r = 1 + row_parity + 2*i;
+                for (int c = 1 + col_parity; c <= grid->cols; c += 2) {
+                    update_cell(engine, grid, r, c);
+                }
+            }
+            pool_barrier(pool, rank);
+        }
+    }
+
+}
+
+
+static void colored_step(ca_engine_t *engine, int generations) {
+
+    colored_t *colored = (colored_t*) engine->state;
+
+    if (generations > colored->capacity) {
+        colored->orders = (unsigned char*) realloc(colored->orders,
+                                                   (size_t)generations * COLORS);
+        colored->capacity = generations;
+    }
+
+    // shuffle the colors of every timestep (Fisher-Yates)
+    for (int t = 0; t < generations; t++) {
+        unsigned char *order = colored->orders + (size_t)t * COLORS;
+        for (int k = 0; k < COLORS; k++) {
+            order[k] = k;
+        }
+        for (int k = COLORS - 1; k > 0; k--) {
+            int j = prng_below(&engine->prng, k + 1);
+            unsigned char tmp = order[k];
+            order[k] = order[j];
+            order[j] = tmp;
+        }
+    }
+
+    colored->generations = generations;
+    pool_run(colored->pool, colored_run, colored);
+
+}
+
+
+static void colored_describe(ca_engine_t *engine, char *buf, size_t len) {
+
+    colored_t *colored = (colored_t*) engine->state;
+    snprintf(buf, len, ", threads: %d, colors: %d", colored->pool->threads, COLORS);
+
+}
+
+
+static void colored_fini(ca_engine_t *engine) {
+
+    colored_t *colored = (colored_t*) engine->state;
+    pool_free(colored->pool);
+    free(colored->orders);
+    free(colored);
+
+}
+
+
+const ca_backend_t ca_backend_rand_order_pthreads = {
+    .name = "rand_order_pthreads",
+    .kernels = CA_KERNEL_INT,
+    .random = true,
+    .init = colored_init,
+    .step = colored_step,
+    .describe = colored_describe,
+    .fini = colored_fini,
+};
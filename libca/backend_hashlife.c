@@ -0,0 +1,572 @@
+/*
+ * backend_hashlife.c
+ *
+ * HashLife backend for very long synchronous runs. The cellspace is stored
+ * as a quadtree of canonical (hash-consed) nodes: a node of level k is a
+ * 2^k x 2^k square made of four level k-1 children, and identical squares
+ * anywhere in space or time are the same node. For a node of level k the
+ * center 2^(k-1) x 2^(k-1) square 2^j generations later (j <= k-2) only
+ * depends on the node itself, so it is computed once and memoized in the
+ * node. Repetitive regions (still lifes, oscillators, empty space) are
+ * then advanced by many generations per lookup instead of cell by cell.
+ *
+ * Cells have three states. Alive and dead follow the engine's rule (any
+ * Life-like rule, not Generations); wall cells count as live neighbors and
+ * never change.
+ * The ghost border and everything outside it are wall, which reproduces
+ * the fixed border of the other backends exactly.
+ *
+ * The grid sits at offset N/4 of an N x N universe (the root), so the
+ * memoized result of the root is again the whole grid. A step of 2^j
+ * generations grows the root to level j+2 if needed by padding with wall.
+ *
+ * Memory: the memo cache grows with every new square. Between steps the
+ * node count is checked against config.cache_mb; when it is over, nodes
+ * not reachable from the current root are freed and memoized results
+ * pointing to them dropped (mark and sweep). The step size adapts to the
+ * budget too: it doubles while a step creates few new nodes and halves
+ * when one creates too many, so chaotic phases run in short steps and
+ * settled ones in long jumps.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ca_internal.h"
+
+/*memo cache budget when config.cache_mb is 0*/
+#ifndef HASHLIFE_DEFAULT_MB
+#define HASHLIFE_DEFAULT_MB 512
+#endif
+
+#define NODES_PER_BLOCK 16384
+#define MAX_LEVEL 40
+
+enum { DEAD, ALIVE, WALL };
+
+typedef struct node node_t;
+struct node {
+    node_t *nw, *ne, *sw, *se;  /* children, NULL at level 0 */
+    node_t *result;             /* center after 2^result_j generations */
+    node_t *next;               /* hash chain */
+    int level;
+    signed char result_j;
+    unsigned char state;        /* level 0 only */
+    unsigned char mark;
+};
+
+typedef struct block {
+    struct block *next;
+    node_t nodes[NODES_PER_BLOCK];
+} block_t;
+
+typedef struct {
+    node_t leaf[3];             /* level 0 nodes, one per state */
+    node_t *wall[MAX_LEVEL];    /* all-wall node of each level */
+
+    node_t **table;
+    size_t buckets;
+    size_t count;
+    block_t *blocks;
+    size_t block_used;          /* nodes handed out from blocks */
+    node_t *free_list;
+
+    unsigned birth;             /* rule masks, see rule.h */
+    unsigned survive;
+
+    node_t *root;
+    int max_j;                  /* current step size is at most 2^max_j */
+    size_t budget;              /* node budget from config.cache_mb */
+    long long collections;
+} hashlife_t;
+
+
+/* ================= canonical nodes ================= */
+
+static size_t node_hash(const node_t *nw, const node_t *ne,
+                        const node_t *sw, const node_t *se) {
+
+    uintptr_t h = (uintptr_t)nw;
+    h = h * 1000003u + (uintptr_t)ne;
+    h = h * 1000003u + (uintptr_t)sw;
+    h = h * 1000003u + (uintptr_t)se;
+    return (size_t)(h ^ (h >> 17));
+
+}
+
+
+static node_t *alloc_node(hashlife_t *hl) {
+
+    if (hl->free_list != NULL) {
+        node_t *n = hl->free_list;
+        hl->free_list = n->next;
+        return n;
+    }
+    if (hl->blocks == NULL || hl->block_used == NODES_PER_BLOCK) {
+        block_t *b = (block_t*) malloc(sizeof(block_t));
+        if (b == NULL) {
+            printf("ERROR: hashlife ran out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        b->next = hl->blocks;
+        hl->blocks = b;
+        hl->block_used = 0;
+    }
+    return &hl->blocks->nodes[hl->block_used++];
+
+}
+
+
+static void grow_table(hashlife_t *hl) {
+
+    size_t buckets = hl->buckets * 2;
+    node_t **table = (node_t**) calloc(buckets, sizeof(node_t*));
+
+    for (size_t i = 0; i < hl->buckets; i++) {
+        node_t *n = hl->table[i];
+        while (n != NULL) {
+            node_t *next = n->next;
+            size_t h = node_hash(n->nw, n->ne, n->sw, n->se) & (buckets - 1);
+            n->next = table[h];
+            table[h] = n;
+            n = next;
+        }
+    }
+    free(hl->table);
+    hl->table = table;
+    hl->buckets = buckets;
+
+}
+
+
+/*
+ * The unique node with these four children.
+ */
+static node_t *find_node(hashlife_t *hl, node_t *nw, node_t *ne,
+                         node_t *sw, node_t *se) {
+
+    size_t h = node_hash(nw, ne, sw, se) & (hl->buckets - 1);
+    for (node_t *n = hl->table[h]; n != NULL; n = n->next) {
+        if (n->nw == nw && n->ne == ne && n->sw == sw && n->se == se) {
+            return n;
+        }
+    }
+
+    node_t *n = alloc_node(hl);
+    n->nw = nw;
+    n->ne = ne;
+    n->sw = sw;
+    n->se = se;
+    n->result = NULL;
+    n->result_j = -1;
+    n->level = nw->level + 1;
+    n->state = DEAD;
+    n->mark = 0;
+    n->next = hl->table[h];
+    hl->table[h] = n;
+
+    if (++hl->count > hl->buckets) {
+        grow_table(hl);
+    }
+    return n;
+
+}
+
+
+/* ================= evolution ================= */
+
+static int cell_state(const node_t *n, int r, int c) {
+
+    // walk a level 2 node down to the cell at (r,c)
+    for (int half = 2; half >= 1; half /= 2) {
+        if (r < half) {
+            n = (c < half) ? n->nw : n->ne;
+        } else {
+            n = (c < half) ? n->sw : n->se;
+        }
+        r %= half;
+        c %= half;
+    }
+    return n->state;
+
+}
+
+
+/*
+ * Center 2x2 of a level 2 node after one generation.
+ */
+static node_t *base_result(hashlife_t *hl, node_t *n) {
+
+    int s[4][4];
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 4; c++) {
+            s[r][c] = cell_state(n, r, c);
+        }
+    }
+
+    node_t *out[4];
+    for (int k = 0; k < 4; k++) {
+        int r = 1 + k/2, c = 1 + k%2;
+        if (s[r][c] == WALL) {
+            out[k] = &hl->leaf[WALL];
+            continue;
+        }
+        int livingNeighbors = 0;
+        for (int i = r-1; i <= r+1; i++) {
+            for (int j = c-1; j <= c+1; j++) {
+                if ((i != r || j != c) && s[i][j] != DEAD) {
+                    livingNeighbors++;
+                }
+            }
+        }
+        unsigned mask = (s[r][c] == ALIVE) ? hl->survive : hl->birth;
+        bool alive = (mask >> livingNeighbors) & 1;
+        out[k] = &hl->leaf[alive ? ALIVE : DEAD];
+    }
+    return find_node(hl, out[0], out[1], out[2], out[3]);
+
+}
+
+
+/*
+ * Center level k-1 square of a level k node, without advancing time.
+ */
+static node_t *center(hashlife_t *hl, node_t *n) {
+
+    return find_node(hl, n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+
+}
+
+
+/*
+ * Center level k-1 square of level k node n after 2^j generations,
+ * j <= k-2.
+ */
+static node_t *result(hashlife_t *hl, node_t *n, int j) {
+
+    if (n->result != NULL && n->result_j == j) {
+        return n->result;
+    }
+    if (n == hl->wall[n->level]) {
+        return hl->wall[n->level - 1];
+    }
+
+    node_t *r;
+    if (n->level == 2) {
+        r = base_result(hl, n);
+    } else {
+        // the nine overlapping level k-1 squares
+        node_t *sq[3][3];
+        sq[0][0] = n->nw;
+        sq[0][1] = find_node(hl, n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw);
+        sq[0][2] = n->ne;
+        sq[1][0] = find_node(hl, n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne);
+        sq[1][1] = center(hl, n);
+        sq[1][2] = find_node(hl, n->ne->sw, n->ne->se, n->se->nw, n->se->ne);
+        sq[2][0] = n->sw;
+        sq[2][1] = find_node(hl, n->sw->ne, n->se->nw, n->sw->se, n->se->sw);
+        sq[2][2] = n->se;
+
+        // full step: both halves advance; shorter step: only the second one
+        bool full = (j == n->level - 2);
+        node_t *m[3][3];
+        for (int y = 0; y < 3; y++) {
+            for (int x = 0; x < 3; x++) {
+                m[y][x] = full ? result(hl, sq[y][x], j-1) : center(hl, sq[y][x]);
+            }
+        }
+
+        int jj = full ? j-1 : j;
+        node_t *q[2][2];
+        for (int y = 0; y < 2; y++) {
+            for (int x = 0; x < 2; x++) {
+                q[y][x] = result(hl, find_node(hl, m[y][x], m[y][x+1],
+                                               m[y+1][x], m[y+1][x+1]), jj);
+            }
+        }
+        r = find_node(hl, q[0][0], q[0][1], q[1][0], q[1][1]);
+    }
+
+    n->result = r;
+    n->result_j = (signed char)j;
+    return r;
+
+}
+
+
+/* ================= universe ================= */
+
+/*
+ * Node of the given level with its top-left corner at universe (y,x).
+ * The grid (ghost border included) has its top-left corner at (o,o).
+ */
+static node_t *build(hashlife_t *hl, const ca_grid_t *grid, int level,
+                     long y, long x, long o) {
+
+    long size = 1L << level;
+    if (y + size <= o || x + size <= o || y >= o + grid->max_rows || x >= o + grid->max_cols) {
+        return hl->wall[level];
+    }
+    if (level == 0) {
+        long r = y - o, c = x - o;
+        if (r == 0 || c == 0 || r == grid->max_rows-1 || c == grid->max_cols-1) {
+            return &hl->leaf[WALL];
+        }
+        return &hl->leaf[*(grid->cells + r*grid->max_cols + c) ? ALIVE : DEAD];
+    }
+
+    long h = size / 2;
+    return find_node(hl, build(hl, grid, level-1, y, x, o),
+                         build(hl, grid, level-1, y, x+h, o),
+                         build(hl, grid, level-1, y+h, x, o),
+                         build(hl, grid, level-1, y+h, x+h, o));
+
+}
+
+
+/*
+ * Write the cells of node n (top-left corner at grid row/col (r,c)) into
+ * the interior of the grid.
+ */
+static void extract(const hashlife_t *hl, const node_t *n, ca_grid_t *grid,
+                    long r, long c) {
+
+    long size = 1L << n->level;
+    if (r + size <= 0 || c + size <= 0 || r >= grid->max_rows || c >= grid->max_cols) {
+        return;
+    }
+    // wall only covers the ghost border, which the grid already holds
+    if (n == hl->wall[n->level]) {
+        return;
+    }
+    if (n->level == 0) {
+        *(grid->cells + r*grid->max_cols + c) = (n->state == ALIVE) ? 1 : 0;
+        return;
+    }
+
+    long h = size / 2;
+    extract(hl, n->nw, grid, r, c);
+    extract(hl, n->ne, grid, r, c+h);
+    extract(hl, n->sw, grid, r+h, c);
+    extract(hl, n->se, grid, r+h, c+h);
+
+}
+
+
+/*
+ * Level k root holding level k-1 node c as its center.
+ */
+static node_t *embed(hashlife_t *hl, node_t *c) {
+
+    node_t *w = hl->wall[c->level - 1];
+    return find_node(hl, find_node(hl, w, w, w, c->nw),
+                         find_node(hl, w, w, c->ne, w),
+                         find_node(hl, w, c->sw, w, w),
+                         find_node(hl, c->se, w, w, w));
+
+}
+
+
+/*
+ * Grow the root to the given level, keeping the grid at offset N/4.
+ */
+static void grow_root(hashlife_t *hl, int level) {
+
+    if (hl->root->level >= level) {
+        return;
+    }
+    // the grid sits in the top-left corner of the root's center
+    node_t *c = center(hl, hl->root);
+    while (c->level < level - 1) {
+        node_t *w = hl->wall[c->level];
+        c = find_node(hl, c, w, w, w);
+    }
+    hl->root = embed(hl, c);
+
+}
+
+
+/* ================= memory ================= */
+
+static void mark(node_t *n) {
+
+    if (n->level == 0 || n->mark) {
+        return;
+    }
+    n->mark = 1;
+    mark(n->nw);
+    mark(n->ne);
+    mark(n->sw);
+    mark(n->se);
+
+}
+
+
+/*
+ * Free every node not reachable from the root or the wall nodes, and drop
+ * memoized results that pointed to one.
+ */
+static void collect(hashlife_t *hl) {
+
+    mark(hl->root);
+    for (int k = 1; k < MAX_LEVEL; k++) {
+        mark(hl->wall[k]);
+    }
+
+    for (size_t i = 0; i < hl->buckets; i++) {
+        node_t **link = &hl->table[i];
+        while (*link != NULL) {
+            node_t *n = *link;
+            if (n->mark) {
+                link = &n->next;
+                continue;
+            }
+            *link = n->next;
+            n->next = hl->free_list;
+            hl->free_list = n;
+            hl->count--;
+        }
+    }
+
+    for (size_t i = 0; i < hl->buckets; i++) {
+        for (node_t *n = hl->table[i]; n != NULL; n = n->next) {
+            if (n->result != NULL && n->result->level > 0 && !n->result->mark) {
+                n->result = NULL;
+                n->result_j = -1;
+            }
+        }
+    }
+    for (size_t i = 0; i < hl->buckets; i++) {
+        for (node_t *n = hl->table[i]; n != NULL; n = n->next) {
+            n->mark = 0;
+        }
+    }
+    hl->collections++;
+
+}
+
+
+/* ================= backend ================= */
+
+static int hashlife_init(ca_engine_t *engine) {
+
+    ca_grid_t *grid = engine->grid;
+    if (engine->rule.states > 2) {
+        printf("ERROR: hashlife only runs two state rules\n");
+        return -1;
+    }
+
+    hashlife_t *hl = (hashlife_t*) calloc(1, sizeof(hashlife_t));
+    engine->state = hl;
+    engine->kernel_name = "hashlife";
+    hl->birth = engine->rule.birth;
+    hl->survive = engine->rule.survive;
+
+    for (int s = 0; s < 3; s++) {
+        hl->leaf[s].state = (unsigned char)s;
+        hl->leaf[s].result_j = -1;
+    }
+    hl->buckets = 1 << 16;
+    hl->table = (node_t**) calloc(hl->buckets, sizeof(node_t*));
+
+    size_t mb = engine->config.cache_mb > 0 ? (size_t)engine->config.cache_mb : HASHLIFE_DEFAULT_MB;
+    hl->budget = mb * 1024 * 1024 / (sizeof(node_t) + 2*sizeof(node_t*));
+
+    hl->wall[0] = &hl->leaf[WALL];
+    for (int k = 1; k < MAX_LEVEL; k++) {
+        node_t *w = hl->wall[k-1];
+        hl->wall[k] = find_node(hl, w, w, w, w);
+    }
+
+    // the grid has to fit in the center half, whose result is kept
+    int level = 3;
+    while ((1L << (level-1)) < grid->max_rows || (1L << (level-1)) < grid->max_cols) {
+        level++;
+    }
+    if (level > MAX_LEVEL - 2) {
+        printf("ERROR: grid is too large for hashlife\n");
+        return -1;
+    }
+    hl->max_j = level - 2;
+    hl->root = build(hl, grid, level, 0, 0, 1L << (level-2));
+    return 0;
+
+}
+
+
+static void hashlife_step(ca_engine_t *engine, int generations) {
+
+    hashlife_t *hl = (hashlife_t*) engine->state;
+
+    while (generations > 0) {
+        int j = 0;
+        while (j < hl->max_j && (2L << j) <= generations) {
+            j++;
+        }
+
+        size_t before = hl->count;
+        grow_root(hl, j + 2);
+        hl->root = embed(hl, result(hl, hl->root, j));
+        generations -= 1L << j;
+        size_t created = hl->count - before;
+
+        if (hl->count > hl->budget) {
+            collect(hl);
+        }
+        // longer steps while they stay well inside the budget
+        if (created > hl->budget / 4 && hl->max_j > 0) {
+            hl->max_j--;
+        } else if (created < hl->budget / 16 && j == hl->max_j && hl->max_j < MAX_LEVEL - 4) {
+            hl->max_j++;
+        }
+    }
+
+}
+
+
+static void hashlife_sync(ca_engine_t *engine) {
+
+    hashlife_t *hl = (hashlife_t*) engine->state;
+    long o = 1L << (hl->root->level - 2);
+    extract(hl, hl->root, engine->grid, -o, -o);
+
+}
+
+
+static void hashlife_describe(ca_engine_t *engine, char *buf, size_t len) {
+
+    hashlife_t *hl = (hashlife_t*) engine->state;
+    snprintf(buf, len, ", nodes: %zu, step: 2^%d, collections: %lld",
+             hl->count, hl->max_j, hl->collections);
+
+}
+
+
+static void hashlife_fini(ca_engine_t *engine) {
+
+    hashlife_t *hl = (hashlife_t*) engine->state;
+
+    while (hl->blocks != NULL) {
+        block_t *next = hl->blocks->next;
+        free(hl->blocks);
+        hl->blocks = next;
+    }
+    free(hl->table);
+    free(hl);
+
+}
+
+
+const ca_backend_t ca_backend_hashlife = {
+    .name = "hashlife",
+    .kernels = CA_KERNEL_INT,
+    .init = hashlife_init,
+    .step = hashlife_step,
+    .sync = hashlife_sync,
+    .describe = hashlife_describe,
+    .fini = hashlife_fini,
+};
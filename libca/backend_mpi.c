@@ -0,0 +1,810 @@
+/*
+ * backend_mpi.c
+ *
+ * Synchronous backend distributed over MPI ranks, built into libca_mpi (and
+ * libca_mpi_omp with OpenMP threads updating each rank's cells). Programs
+ * make it available with ca_mpi_register(). The grid passed to
+ * ca_engine_create() only needs cell storage on rank 0; it holds the initial
+ * state there and receives the result in ca_engine_sync().
+ *
+ * Communication modes:
+ *   allgather  every rank keeps the whole cellspace and gathers it after
+ *              each timestep (default). Needs (rows+2) % nprocs == 0.
+ *   halo       (config.halo) every rank keeps only its own block plus a one
+ *              cell ghost ring and exchanges just those boundary cells with
+ *              its neighbors each timestep. The full cellspace is only
+ *              assembled on rank 0 by ca_engine_sync().
+ *
+ * Decomposition for halo mode: row slabs, or 2D blocks on an MPI_Cart_create
+ * grid (config.decomp_2d) of the shape, among the factorizations of nprocs
+ * that fit the cellspace, whose blocks have the shortest halo. Rows and cols
+ * don't have to divide evenly.
+ *
+ * Overlap (config.overlap, halo mode): the ghost ring exchange is posted with
+ * non-blocking sends/receives, the interior cells that don't touch the ghost
+ * ring are updated while the messages are in flight, and the boundary cells
+ * are finished after MPI_Waitall. ca_engine_describe() reports how much of
+ * the exchange was hidden behind the interior update; for this backend it is
+ * collective and must be called on every rank.
+ *
+ * With config.randomize every rank fills its own slab or block from the
+ * seed instead of receiving it from rank 0; in allgather mode one
+ * MPI_Allgather then completes the cellspace on every rank.
+ *
+ * config.restart and config.pattern work the same way: every rank unpacks
+ * its own slab or block straight from the mapped checkpoint, or parses just
+ * that part of the pattern.
+ *
+ * Snapshots (ca_mpi_snapshot()): each rank writes its own slab or block
+ * into one shared checkpoint file with collective MPI-IO. The file view of a
+ * rank is the subarray of the global cellspace it owns, so MPI_File_write_all
+ * can merge the pieces into large contiguous writes and no rank ever holds
+ * more than its own part. The result is an ordinary checkpoint (backend
+ * "mpi") that any synchronous backend can restart from.
+ *
+ * With config.affinity the ranks sharing a node split its CPUs: local rank
+ * r pins its threads (one, or the OpenMP team) to slots r * threads on.
+ * ca_engine_placement() lists the calling rank's threads only.
+ *
+ * Profiling (PROFILE=1) keeps one slot per rank, for its calling thread:
+ * waiting for the other ranks in MPI_Barrier counts as barrier, the
+ * allgather, halo messages and the gathers of ca_engine_sync() as comm.
+ * ca_engine_profile() gathers the slots and rank 0 prints a row per rank.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "ca_internal.h"
+#include "ca_mpi.h"
+#include "checkpoint.h"
+
+/*neighbor directions*/
+enum { NORTH, SOUTH, WEST, EAST, NW, NE, SW, SE, NUM_DIRS };
+
+typedef struct {
+    int my_rank;
+    int nprocs;
+
+    /*allgather mode: whole cellspace on every rank, this rank's slab*/
+    int *global_cells;
+    int *local_cells;
+    int slab_rows;
+
+    /*halo mode: block owned by this rank in the process grid*/
+    MPI_Comm cart_comm;
+    int dims[2];
+    int coords[2];
+    int local_rows;
+    int local_cols;
+    int local_stride;
+    int first_row;
+    int first_col;
+    int *local_next;
+
+    /*neighbor ranks, MPI_PROC_NULL outside the cellspace*/
+    int neighbors[NUM_DIRS];
+
+    /*boundary row and boundary column of the local block*/
+    MPI_Datatype row_type;
+    MPI_Datatype col_type;
+
+    /*per cell kernel and its rule*/
+    cell_kernel_t transition;
+    const ca_rule_t *rule;
+
+    /*overlap mode: time spent on the interior update and waiting for the halo*/
+    double interior_time;
+    double wait_time;
+
+    profile_t *profile;
+} mpi_state_t;
+
+
+/* ================= allgather mode ================= */
+
+static int allgather_init(ca_engine_t *engine, mpi_state_t *s) {
+
+    ca_grid_t *grid = engine->grid;
+    const int mr = grid->max_rows, mc = grid->max_cols;
+
+    // every rank gets the same number of rows, ghost border included
+    if (mr % s->nprocs != 0) {
+        if (s->my_rank == 0) {
+            printf("ERROR: allgather mode needs rows + 2 (%d) to be a multiple of the %d procs, or use halo mode.\n",
+                   mr, s->nprocs);
+        }
+        return -1;
+    }
+
+    s->slab_rows = mr / s->nprocs;
+    s->global_cells = (s->my_rank == 0) ? grid->cells
+                                        : (int*) ca_alloc((size_t)mr * mc * sizeof(int));
+    s->local_cells = (int*) ca_alloc((size_t)s->slab_rows * mc * sizeof(int));
+
+    // every rank starts from rank 0's cellspace, unless they fill their own
+    if (engine->config.randomize || engine->restart != NULL || engine->pattern != NULL) {
+        return 0;
+    }
+    if (MPI_Bcast(s->global_cells, mr * mc, MPI_INT, 0, MPI_COMM_WORLD) != MPI_SUCCESS) {
+        perror("Broadcast error in CA routine");
+        exit(1);
+    }
+    memcpy(s->local_cells, s->global_cells + s->my_rank * s->slab_rows * mc,
+           (size_t)s->slab_rows * mc * sizeof(int));
+    return 0;
+
+}
+
+
+static void allgather_step(ca_engine_t *engine, mpi_state_t *s, int generations) {
+
+    const int mr = engine->grid->max_rows, mc = engine->grid->max_cols;
+
+    // rows of the global array this rank computes, without the ghost rows
+    int slab_start = s->my_rank * s->slab_rows;
+    int start_rows = slab_start > 1 ? slab_start : 1;
+    int end_rows = slab_start + s->slab_rows < mr-1 ? slab_start + s->slab_rows : mr-1;
+
+    for (int t = 0; t < generations; t++) {
+
+        # pragma omp parallel for
+        for (int i = start_rows; i < end_rows; i++) {
+            int index_rows_in_local = i - slab_start;
+            for (int j = 1; j < mc-1; j++) {
+                *(s->local_cells + index_rows_in_local*mc + j) =
+                    s->transition(s->rule, s->global_cells, mc, i, j);
+            }
+        }
+
+        PROFILE_BEGIN(s->profile, 0, PROFILE_BARRIER);
+        MPI_Barrier(MPI_COMM_WORLD);
+
+        PROFILE_SWITCH(s->profile, 0, PROFILE_COMM);
+        if (MPI_Allgather(s->local_cells, s->slab_rows * mc, MPI_INT,
+                          s->global_cells, s->slab_rows * mc, MPI_INT,
+                          MPI_COMM_WORLD) != MPI_SUCCESS) {
+            perror("Gather error");
+            exit(1);
+        }
+
+        PROFILE_SWITCH(s->profile, 0, PROFILE_BARRIER);
+        MPI_Barrier(MPI_COMM_WORLD);
+        PROFILE_END(s->profile, 0);
+    }
+
+}
+
+
+/* ================= halo mode ================= */
+
+/*
+ * Split n cells into parts blocks that differ by at most one and return the
+ * size and first (global, ghost border counted) index of block idx.
+ */
+static void split_block(int n, int parts, int idx, int* count, int* first) {
+
+    *count = n / parts + (idx < n % parts ? 1 : 0);
+    *first = 1 + idx * (n / parts) + (idx < n % parts ? idx : n % parts);
+
+}
+
+
+/*
+ * Subarray type for a rows x cols block starting at (row, col) of a matrix
+ * with total_rows x total_cols cells.
+ */
+static MPI_Datatype block_type(int total_rows, int total_cols, int rows, int cols,
+                               int row, int col) {
+
+    MPI_Datatype type;
+    int sizes[2] = {total_rows, total_cols};
+    int subsizes[2] = {rows, cols};
+    int starts[2] = {row, col};
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_INT, &type);
+    MPI_Type_commit(&type);
+    return type;
+
+}
+
+
+/*
+ * Send each rank its block of the cellspace from rank 0 (scatter), or
+ * assemble the blocks on rank 0 (gather).
+ */
+static void move_blocks(ca_engine_t *engine, mpi_state_t *s, int *local, bool scatter) {
+
+    ca_grid_t *grid = engine->grid;
+    MPI_Datatype local_type = block_type(s->local_rows + 2, s->local_stride,
+                                         s->local_rows, s->local_cols, 1, 1);
+    int tag = scatter ? 0 : 1;
+    MPI_Request local_req;
+    if (scatter) {
+        MPI_Irecv(local, 1, local_type, 0, tag, s->cart_comm, &local_req);
+    } else {
+        MPI_Isend(local, 1, local_type, 0, tag, s->cart_comm, &local_req);
+    }
+
+    if (s->my_rank == 0) {
+        MPI_Request *reqs = (MPI_Request*) malloc(s->nprocs * sizeof(MPI_Request));
+        MPI_Datatype *types = (MPI_Datatype*) malloc(s->nprocs * sizeof(MPI_Datatype));
+        for (int r = 0; r < s->nprocs; r++) {
+            int c[2], rows, cols, row, col;
+            MPI_Cart_coords(s->cart_comm, r, 2, c);
+            split_block(grid->rows, s->dims[0], c[0], &rows, &row);
+            split_block(grid->cols, s->dims[1], c[1], &cols, &col);
+            types[r] = block_type(grid->max_rows, grid->max_cols, rows, cols, row, col);
+            if (scatter) {
+                MPI_Isend(grid->cells, 1, types[r], r, tag, s->cart_comm, &reqs[r]);
+            } else {
+                MPI_Irecv(grid->cells, 1, types[r], r, tag, s->cart_comm, &reqs[r]);
+            }
+        }
+        MPI_Waitall(s->nprocs, reqs, MPI_STATUSES_IGNORE);
+        for (int r = 0; r < s->nprocs; r++) {
+            MPI_Type_free(&types[r]);
+        }
+        free(types);
+        free(reqs);
+    }
+
+    MPI_Wait(&local_req, MPI_STATUS_IGNORE);
+    MPI_Type_free(&local_type);
+
+}
+
+
+/*
+ * Shape the process grid: nprocs x 1 for row slabs, or with decomp_2d the
+ * d0 x d1 = nprocs that fits rows x cols and has the smallest block
+ * perimeter (ties go to more row blocks). Returns -1 if none fits.
+ */
+static int grid_dims(int nprocs, int rows, int cols, bool decomp_2d, int dims[2]) {
+
+    int best = -1;
+    for (int d0 = decomp_2d ? 1 : nprocs; d0 <= nprocs; d0++) {
+        int d1 = nprocs / d0;
+        if (nprocs % d0 != 0 || d0 > rows || d1 > cols) {
+            continue;
+        }
+        int perimeter = (rows + d0 - 1) / d0 + (cols + d1 - 1) / d1;
+        if (best < 0 || perimeter <= best) {
+            best = perimeter;
+            dims[0] = d0;
+            dims[1] = d1;
+        }
+    }
+    return best < 0 ? -1 : 0;
+
+}
+
+
+/*
+ * Build the process grid for halo mode, allocate this rank's block with its
+ * ghost ring and scatter the initial state.
+ */
+static int halo_init(ca_engine_t *engine, mpi_state_t *s) {
+
+    ca_grid_t *grid = engine->grid;
+
+    if (grid_dims(s->nprocs, grid->rows, grid->cols, engine->config.decomp_2d, s->dims) != 0) {
+        if (s->my_rank == 0) {
+            printf("ERROR: no %s grid of %d procs fits %d x %d cells.\n",
+                   engine->config.decomp_2d ? "2D" : "row slab", s->nprocs,
+                   grid->rows, grid->cols);
+        }
+        return -1;
+    }
+
+    int periods[2] = {0, 0};
+    MPI_Cart_create(MPI_COMM_WORLD, 2, s->dims, periods, 0, &s->cart_comm);
+    MPI_Cart_coords(s->cart_comm, s->my_rank, 2, s->coords);
+
+    split_block(grid->rows, s->dims[0], s->coords[0], &s->local_rows, &s->first_row);
+    split_block(grid->cols, s->dims[1], s->coords[1], &s->local_cols, &s->first_col);
+    s->local_stride = s->local_cols + 2;
+
+    // neighbor in each direction, or MPI_PROC_NULL past the edge of the grid
+    int offsets[NUM_DIRS][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1},
+                                {-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+    for (int d = 0; d < NUM_DIRS; d++) {
+        int c[2] = {s->coords[0] + offsets[d][0], s->coords[1] + offsets[d][1]};
+        if (c[0] < 0 || c[0] >= s->dims[0] || c[1] < 0 || c[1] >= s->dims[1]) {
+            s->neighbors[d] = MPI_PROC_NULL;
+        } else {
+            MPI_Cart_rank(s->cart_comm, c, &s->neighbors[d]);
+        }
+    }
+
+    MPI_Type_contiguous(s->local_cols, MPI_INT, &s->row_type);
+    MPI_Type_commit(&s->row_type);
+    MPI_Type_vector(s->local_rows, 1, s->local_stride, MPI_INT, &s->col_type);
+    MPI_Type_commit(&s->col_type);
+
+    // the ghost ring starts out as the outer border; inner ghosts get
+    // overwritten by the first exchange
+    int size = (s->local_rows + 2) * s->local_stride;
+    s->local_cells = (int*) ca_alloc(size * sizeof(int));
+    s->local_next = (int*) ca_alloc(size * sizeof(int));
+    for (int i = 0; i < size; i++) {
+        s->local_cells[i] = 1;
+        s->local_next[i] = 1;
+    }
+
+    if (!engine->config.randomize && engine->restart == NULL && engine->pattern == NULL) {
+        move_blocks(engine, s, s->local_cells, true);
+    }
+    return 0;
+
+}
+
+
+/*
+ * Post the exchange of boundary cells with all eight neighbors: edges use the
+ * row/column types and the diagonal neighbors get a single corner cell, so
+ * the ghost ring is complete after finish_halo_exchange(). A message sent in
+ * direction d is tagged d, and received from the opposite neighbor.
+ */
+static void start_halo_exchange(mpi_state_t *s, int* p, MPI_Request* reqs) {
+
+    int lr = s->local_rows, lc = s->local_cols, w = s->local_stride;
+    int *send[NUM_DIRS] = {
+        p + 1*w + 1, p + lr*w + 1, p + 1*w + 1, p + 1*w + lc,
+        p + 1*w + 1, p + 1*w + lc, p + lr*w + 1, p + lr*w + lc
+    };
+    int *recv[NUM_DIRS] = {
+        p + 0*w + 1, p + (lr+1)*w + 1, p + 1*w + 0, p + 1*w + (lc+1),
+        p + 0*w + 0, p + 0*w + (lc+1), p + (lr+1)*w + 0, p + (lr+1)*w + (lc+1)
+    };
+    MPI_Datatype types[NUM_DIRS] = {
+        s->row_type, s->row_type, s->col_type, s->col_type,
+        MPI_INT, MPI_INT, MPI_INT, MPI_INT
+    };
+    int opposite[NUM_DIRS] = {SOUTH, NORTH, EAST, WEST, SE, SW, NE, NW};
+
+    for (int d = 0; d < NUM_DIRS; d++) {
+        MPI_Irecv(recv[d], 1, types[d], s->neighbors[d], opposite[d], s->cart_comm, &reqs[d]);
+    }
+    for (int d = 0; d < NUM_DIRS; d++) {
+        MPI_Isend(send[d], 1, types[d], s->neighbors[d], d, s->cart_comm, &reqs[NUM_DIRS + d]);
+    }
+
+}
+
+
+/*
+ * Wait for the exchange posted by start_halo_exchange().
+ */
+static void finish_halo_exchange(MPI_Request* reqs) {
+
+    if (MPI_Waitall(2*NUM_DIRS, reqs, MPI_STATUSES_IGNORE) != MPI_SUCCESS) {
+        perror("Halo exchange error");
+        exit(1);
+    }
+
+}
+
+
+/*
+ * Update the local cells in rows [row_start, row_end] and cols
+ * [col_start, col_end] (inclusive, local indices) into local_next.
+ */
+static void update_block(mpi_state_t *s, int row_start, int row_end,
+                         int col_start, int col_end) {
+
+    # pragma omp parallel for
+    for (int i = row_start; i <= row_end; i++) {
+        for (int j = col_start; j <= col_end; j++) {
+            *(s->local_next + i*(s->local_stride) + j) =
+                s->transition(s->rule, s->local_cells, s->local_stride, i, j);
+        }
+    }
+
+}
+
+
+static void halo_step(mpi_state_t *s, bool overlap, int generations) {
+
+    int lr = s->local_rows, lc = s->local_cols;
+    MPI_Request reqs[2*NUM_DIRS];
+
+    for (int t = 0; t < generations; t++) {
+
+        PROFILE_BEGIN(s->profile, 0, PROFILE_COMM);
+        start_halo_exchange(s, s->local_cells, reqs);
+        PROFILE_END(s->profile, 0);
+
+        if (overlap) {
+            // interior cells only read owned cells, so they can go first
+            double start = MPI_Wtime();
+            update_block(s, 2, lr-1, 2, lc-1);
+            double waiting = MPI_Wtime();
+            PROFILE_SWITCH(s->profile, 0, PROFILE_COMM);
+            finish_halo_exchange(reqs);
+            PROFILE_SWITCH(s->profile, 0, PROFILE_COMPUTE);
+            s->interior_time += waiting - start;
+            s->wait_time += MPI_Wtime() - waiting;
+
+            // then the boundary ring that reads the ghost cells
+            update_block(s, 1, 1, 1, lc);
+            if (lr > 1) {
+                update_block(s, lr, lr, 1, lc);
+            }
+            update_block(s, 2, lr-1, 1, 1);
+            if (lc > 1) {
+                update_block(s, 2, lr-1, lc, lc);
+            }
+        } else {
+            PROFILE_SWITCH(s->profile, 0, PROFILE_COMM);
+            finish_halo_exchange(reqs);
+            PROFILE_SWITCH(s->profile, 0, PROFILE_COMPUTE);
+            update_block(s, 1, lr, 1, lc);
+        }
+
+        int *tmp = s->local_cells;
+        s->local_cells = s->local_next;
+        s->local_next = tmp;
+    }
+
+}
+
+
+/* ================= backend ================= */
+
+static int mpi_init(ca_engine_t *engine) {
+
+    mpi_state_t *s = (mpi_state_t*) calloc(1, sizeof(mpi_state_t));
+    MPI_Comm_rank(MPI_COMM_WORLD, &s->my_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &s->nprocs);
+    s->transition = engine->transition;
+    s->rule = &engine->rule;
+    s->profile = engine->profile;
+    engine->state = s;
+
+    // ranks on one node take consecutive slots, threads within a rank too
+    if (engine->config.affinity != NULL) {
+        MPI_Comm node_comm;
+        int local_rank;
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+        MPI_Comm_rank(node_comm, &local_rank);
+        MPI_Comm_free(&node_comm);
+#ifdef _OPENMP
+        int threads = omp_get_max_threads();
+        ca_engine_affinity(engine, threads, local_rank * threads);
+        # pragma omp parallel
+        affinity_pin(&engine->affinity, omp_get_thread_num());
+#else
+        ca_engine_affinity(engine, 1, local_rank);
+        affinity_pin(&engine->affinity, 0);
+#endif
+    }
+
+    // overlap and 2D blocks only exist with halo exchange
+    if (engine->config.decomp_2d || engine->config.overlap) {
+        engine->config.halo = true;
+    }
+
+    int err = engine->config.halo ? halo_init(engine, s) : allgather_init(engine, s);
+    if (err != 0) {
+        free(s);
+        engine->state = NULL;
+    }
+    return err;
+
+}
+
+
+static void mpi_step(ca_engine_t *engine, int generations) {
+
+    mpi_state_t *s = (mpi_state_t*) engine->state;
+
+    if (engine->config.halo) {
+        halo_step(s, engine->config.overlap, generations);
+    } else {
+        allgather_step(engine, s, generations);
+    }
+
+}
+
+
+static void mpi_sync(ca_engine_t *engine) {
+
+    mpi_state_t *s = (mpi_state_t*) engine->state;
+
+    // in allgather mode rank 0's global copy is grid->cells already
+    if (engine->config.halo) {
+        PROFILE_BEGIN(s->profile, 0, PROFILE_COMM);
+        move_blocks(engine, s, s->local_cells, false);
+        PROFILE_END(s->profile, 0);
+    }
+
+}
+
+
+/*
+ * n cells of row x from column col on (ghost border counted), from the
+ * checkpoint being restarted or else from the seed. Dead with a pattern,
+ * which is placed afterwards.
+ */
+static void fill_cells(ca_engine_t *engine, int x, int col, int n, int *dst) {
+
+    if (engine->restart != NULL) {
+        checkpoint_cells(engine->restart, x, col, n, dst);
+    } else if (engine->pattern != NULL) {
+        memset(dst, 0, n * sizeof(int));
+    } else {
+        ca_random_cells(engine->config.seed, engine->grid->cols, x, col, n, dst);
+    }
+
+}
+
+
+/*
+ * config.randomize, config.restart, config.pattern: fill this rank's part of
+ * the cellspace.
+ */
+static void mpi_randomize(ca_engine_t *engine) {
+
+    mpi_state_t *s = (mpi_state_t*) engine->state;
+    ca_grid_t *grid = engine->grid;
+    const int mr = grid->max_rows, mc = grid->max_cols;
+
+    if (engine->config.halo) {
+        // the ghost ring is all 1's from halo_init
+        for (int i = 1; i <= s->local_rows; i++) {
+            fill_cells(engine, s->first_row + i - 1, s->first_col, s->local_cols,
+                       s->local_cells + i*s->local_stride + 1);
+        }
+        if (engine->pattern != NULL) {
+            pattern_place(engine->pattern, s->first_row, s->local_rows, s->first_col,
+                          s->local_cols, s->local_cells + s->local_stride + 1, s->local_stride);
+        }
+        // rank 0's interior arrives with ca_engine_sync(), the border never does
+        if (s->my_rank == 0) {
+            ca_grid_set_border(grid);
+        }
+        return;
+    }
+
+    for (int x = s->my_rank * s->slab_rows; x < (s->my_rank + 1) * s->slab_rows; x++) {
+        int *row = s->global_cells + (size_t)x*mc;
+        if (x == 0 || x == mr-1) {
+            for (int y = 0; y < mc; y++) {
+                row[y] = 1;
+            }
+        } else {
+            row[0] = row[mc-1] = 1;
+            fill_cells(engine, x, 1, grid->cols, row + 1);
+        }
+    }
+    if (engine->pattern != NULL) {
+        // the interior rows of the slab
+        int start = s->my_rank * s->slab_rows > 1 ? s->my_rank * s->slab_rows : 1;
+        int end = (s->my_rank + 1) * s->slab_rows < mr-1 ? (s->my_rank + 1) * s->slab_rows : mr-1;
+        if (end > start) {
+            pattern_place(engine->pattern, start, end - start, 1, grid->cols,
+                          s->global_cells + (size_t)start*mc + 1, mc);
+        }
+    }
+    MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, s->global_cells,
+                  s->slab_rows * mc, MPI_INT, MPI_COMM_WORLD);
+    memcpy(s->local_cells, s->global_cells + s->my_rank * s->slab_rows * mc,
+           (size_t)s->slab_rows * mc * sizeof(int));
+    if (s->my_rank == 0) {
+        ca_grid_set_border(grid);
+    }
+
+}
+
+
+static void mpi_describe(ca_engine_t *engine, char *buf, size_t len) {
+
+    mpi_state_t *s = (mpi_state_t*) engine->state;
+
+    // share of the exchange (post to completion) spent on interior updates
+    double overlap_times[2] = {s->interior_time, s->wait_time};
+    double total_times[2] = {0.0, 0.0};
+    MPI_Reduce(overlap_times, total_times, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (engine->config.overlap) {
+        double hidden = total_times[0] + total_times[1] > 0.0 ?
+            total_times[0] / (total_times[0] + total_times[1]) : 0.0;
+        snprintf(buf, len, ", comm: halo, procs: %d x %d, overlap: %.1f%%, halo wait: %4.4fs",
+                 s->dims[0], s->dims[1], 100.0 * hidden, total_times[1] / s->nprocs);
+    } else if (engine->config.halo) {
+        snprintf(buf, len, ", comm: halo, procs: %d x %d", s->dims[0], s->dims[1]);
+    } else {
+        snprintf(buf, len, ", comm: allgather");
+    }
+
+}
+
+
+/*
+ * ca_engine_profile(): rank 0 prints every rank's totals.
+ */
+static void mpi_profile(ca_engine_t *engine) {
+
+    mpi_state_t *s = (mpi_state_t*) engine->state;
+    double mine[PROFILE_PHASES];
+    double *all = NULL;
+
+    profile_totals(s->profile, mine);
+    if (s->my_rank == 0) {
+        all = (double*) malloc((size_t)s->nprocs * PROFILE_PHASES * sizeof(double));
+    }
+    MPI_Gather(mine, PROFILE_PHASES, MPI_DOUBLE, all, PROFILE_PHASES, MPI_DOUBLE, 0,
+               MPI_COMM_WORLD);
+    if (s->my_rank == 0) {
+        profile_print(all, s->nprocs, "rank");
+        free(all);
+    }
+
+}
+
+
+static void mpi_fini(ca_engine_t *engine) {
+
+    mpi_state_t *s = (mpi_state_t*) engine->state;
+
+    free(s->local_cells);
+    if (engine->config.halo) {
+        free(s->local_next);
+        MPI_Type_free(&s->row_type);
+        MPI_Type_free(&s->col_type);
+        MPI_Comm_free(&s->cart_comm);
+    } else if (s->my_rank != 0) {
+        free(s->global_cells);
+    }
+    free(s);
+
+}
+
+
+const ca_backend_t ca_backend_mpi = {
+    .name = "mpi",
+    .kernels = CA_KERNEL_INT,
+    .init = mpi_init,
+    .step = mpi_step,
+    .sync = mpi_sync,
+    .describe = mpi_describe,
+    .randomize = mpi_randomize,
+    .fini = mpi_fini,
+    .profile = mpi_profile,
+};
+
+
+/*
+ * Make the mpi backend available to ca_engine_create().
+ */
+int ca_mpi_register() {
+
+    return ca_backend_register(&ca_backend_mpi);
+
+}
+
+
+/* ================= snapshots ================= */
+
+static int snapshot(ca_engine_t *engine, const char *path, bool packed) {
+
+    mpi_state_t *s = (mpi_state_t*) engine->state;
+    const ca_grid_t *grid = engine->grid;
+    const int mr = grid->max_rows, mc = grid->max_cols;
+
+    if (packed && (engine->rule.states > 2 || (engine->config.halo && s->dims[1] > 1))) {
+        if (s->my_rank == 0) {
+            printf("ERROR: packed snapshots need a two state rule and whole rows per rank (allgather or 1D halo)\n");
+        }
+        return -1;
+    }
+    const uint32_t bits = packed ? 1 : 8;
+
+    // the part of the padded cellspace this rank writes: its block plus the
+    // ghost border where it touches the edge, or its whole slab
+    const int *src;
+    int src_stride, row, rows, col, cols;
+    if (engine->config.halo) {
+        int top = s->coords[0] == 0, bottom = s->coords[0] == s->dims[0] - 1;
+        int left = s->coords[1] == 0, right = s->coords[1] == s->dims[1] - 1;
+        row = s->first_row - top;
+        rows = s->local_rows + top + bottom;
+        col = s->first_col - left;
+        cols = s->local_cols + left + right;
+        src_stride = s->local_stride;
+        src = s->local_cells + (1 - top) * src_stride + (1 - left);
+    } else {
+        row = s->my_rank * s->slab_rows;
+        rows = s->slab_rows;
+        col = 0;
+        cols = mc;
+        src_stride = mc;
+        src = s->global_cells + (size_t)row * mc;
+    }
+
+    // file elements: bytes, or the words of a packed row
+    MPI_Datatype elem = packed ? MPI_UINT64_T : MPI_BYTE;
+    const size_t row_bytes = checkpoint_row_bytes(bits, cols);
+    int sizes[2] = {mr, packed ? (int)(checkpoint_row_bytes(bits, mc) / sizeof(uint64_t)) : mc};
+    int subsizes[2] = {rows, packed ? (int)(row_bytes / sizeof(uint64_t)) : cols};
+    int starts[2] = {row, packed ? 0 : col};
+    MPI_Datatype view;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, elem, &view);
+    MPI_Type_commit(&view);
+
+    unsigned char *buf = (unsigned char*) malloc(rows * row_bytes);
+    for (int x = 0; x < rows; x++) {
+        checkpoint_pack_row(src + (size_t)x * src_stride, cols, bits, buf + x * row_bytes);
+    }
+
+    checkpoint_header_t header;
+    checkpoint_fill_header(engine, bits, &header);
+
+    size_t len = strlen(path) + 5;
+    char *tmp = (char*) malloc(len);
+    snprintf(tmp, len, "%s.tmp", path);
+
+    MPI_File fh;
+    int err = MPI_File_open(MPI_COMM_WORLD, tmp, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                            MPI_INFO_NULL, &fh) != MPI_SUCCESS;
+    if (!err) {
+        // drop whatever an earlier attempt left behind
+        err |= MPI_File_set_size(fh, header.payload + header.payload_bytes) != MPI_SUCCESS;
+        if (s->my_rank == 0) {
+            err |= MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_BYTE,
+                                     MPI_STATUS_IGNORE) != MPI_SUCCESS;
+        }
+        err |= MPI_File_set_view(fh, header.payload, elem, view, "native",
+                                 MPI_INFO_NULL) != MPI_SUCCESS;
+        err |= MPI_File_write_all(fh, buf, (int)(rows * row_bytes / (packed ? sizeof(uint64_t) : 1)),
+                                  elem, MPI_STATUS_IGNORE) != MPI_SUCCESS;
+        err |= MPI_File_sync(fh) != MPI_SUCCESS;
+        err |= MPI_File_close(&fh) != MPI_SUCCESS;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &err, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+    // only a complete file replaces the previous snapshot
+    if (s->my_rank == 0) {
+        if (!err && rename(tmp, path) != 0) {
+            err = 1;
+        }
+        if (err) {
+            printf("ERROR: could not write snapshot '%s'\n", path);
+            unlink(tmp);
+        }
+    }
+    MPI_Bcast(&err, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+    free(tmp);
+    free(buf);
+    MPI_Type_free(&view);
+    return err ? -1 : 0;
+
+}
+
+
+/*
+ * Write the current generation to path as a checkpoint, every rank its own
+ * part through a file view over the global cellspace. Collective: every
+ * rank has to call it. packed stores 1 bit per cell (two state rules, each
+ * rank owning whole rows: allgather mode or 1D halo decomposition), else 1
+ * byte. Returns 0 on success, -1 on every rank (after rank 0 printed why)
+ * if the file can't be written; path is then left as it was.
+ */
+int ca_mpi_snapshot(ca_engine_t *engine, const char *path, bool packed) {
+
+    PROFILE_BEGIN(engine->profile, 0, PROFILE_OUTPUT);
+    int err = snapshot(engine, path, packed);
+    PROFILE_END(engine->profile, 0);
+    return err;
+
+}
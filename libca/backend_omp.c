@@ -0,0 +1,144 @@
+/*
+ * backend_omp.c
+ *
+ * Synchronous backend using an OpenMP parallel for over the rows of the grid.
+ * config.threads sets the team size (0 leaves it to OMP_NUM_THREADS). Built
+ * without OpenMP this is the serial sweep. config.affinity pins the team
+ * once in init. Each generation is one parallel region; its loop ends in an
+ * explicit barrier so that the profile can time the wait.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ca_internal.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/* the calling thread's number in the team, its slot in engine->profile */
+static inline int thread_num() {
+
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+
+}
+
+
+static int omp_init(ca_engine_t *engine) {
+
+#ifdef _OPENMP
+    if (engine->config.threads > 0) {
+        omp_set_num_threads(engine->config.threads);
+    }
+    profile_threads(engine->profile, omp_get_max_threads());
+    // the runtime keeps its threads between regions, so they stay pinned
+    if (engine->config.affinity != NULL) {
+        ca_engine_affinity(engine, omp_get_max_threads(), 0);
+        # pragma omp parallel
+        affinity_pin(&engine->affinity, omp_get_thread_num());
+    }
+#endif
+    return 0;
+
+}
+
+
+static void omp_step(ca_engine_t *engine, int generations) {
+
+    ca_grid_t *grid = engine->grid;
+    const int mr = grid->max_rows;
+
+    for (int t = 0; t < generations; t++) {
+        # pragma omp parallel
+        {
+            PROFILE_BEGIN(engine->profile, thread_num(), PROFILE_COMPUTE);
+            if (engine->bitpacked) {
+                # pragma omp for schedule(static) nowait
+                for (int i = 1; i < mr-1; i++) {
+                    bitgrid_step_rows(&engine->packed, engine->packed.cells,
+                                      engine->packed.next, i, i+1);
+                }
+            } else {
+                # pragma omp for schedule(static) nowait
+                for (int i = 1; i < mr-1; i++) {
+                    ca_sweep_rows(engine, grid->cells, grid->next, i, i+1);
+                }
+            }
+            PROFILE_SWITCH(engine->profile, thread_num(), PROFILE_BARRIER);
+            # pragma omp barrier
+            PROFILE_END(engine->profile, thread_num());
+        }
+        if (engine->bitpacked) {
+            bitgrid_swap(&engine->packed);
+        } else {
+            ca_grid_swap(grid);
+        }
+    }
+
+}
+
+
+/*
+ * Fill each row on the thread that the static schedule gives it in a step.
+ */
+static void omp_randomize(ca_engine_t *engine) {
+
+    ca_grid_t *grid = engine->grid;
+    const int mr = grid->max_rows;
+
+    if (grid->rows == 0) {
+        ca_fill_rows(engine, 1, 1);
+        return;
+    }
+#ifdef _OPENMP
+    // bind each thread's share of the static schedule to its node first
+    if (engine->affinity.threads > 0) {
+        # pragma omp parallel
+        {
+            int threads = omp_get_num_threads(), rank = omp_get_thread_num();
+            int base = (mr-2) / threads, extra = (mr-2) % threads;
+            int start = 1 + rank*base + (rank < extra ? rank : extra);
+            ca_bind_rows(engine, rank, start, start + base + (rank < extra ? 1 : 0));
+        }
+    }
+#endif
+    # pragma omp parallel
+    {
+        PROFILE_BEGIN(engine->profile, thread_num(), PROFILE_INIT);
+        # pragma omp for schedule(static)
+        for (int i = 1; i < mr-1; i++) {
+            ca_fill_rows(engine, i, i+1);
+        }
+        PROFILE_END(engine->profile, thread_num());
+    }
+
+}
+
+
+static void omp_describe(ca_engine_t *engine, char *buf, size_t len) {
+
+#ifdef _OPENMP
+    snprintf(buf, len, ", threads: %d", omp_get_max_threads());
+#else
+    snprintf(buf, len, ", threads: 1");
+#endif
+
+}
+
+
+const ca_backend_t ca_backend_omp = {
+    .name = "omp",
+    .kernels = CA_KERNEL_ALL,
+    .init = omp_init,
+    .step = omp_step,
+    .describe = omp_describe,
+    .randomize = omp_randomize,
+};
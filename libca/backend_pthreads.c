@@ -0,0 +1,258 @@
+/*
+ * backend_pthreads.c
+ *
+ * Synchronous backend on a persistent pool of worker threads (pool.c). The
+ * pool is created with the engine and parked between ca_engine_step()
+ * calls; the calling thread works as rank 0, so config.threads counts it
+ * too.
+ *
+ * Each thread owns a band of rows (the first ROWS % threads threads get one
+ * extra row, so any thread count works) and keeps its own pointers to the
+ * current and next generation, swapping them after every timestep. One
+ * barrier per timestep is enough: a buffer is only written again after every
+ * thread has passed the barrier that ends the sweep reading it.
+ *
+ * With activity tracking (config.tile_size > 0) the threads own bands of
+ * whole tile rows instead and skip the tiles that can't change (tiles.c).
+ * The tile flags are double buffered by generation parity like the cells,
+ * so the same barrier also orders the flag writes and reads.
+ *
+ * The barrier is the sense-reversing spin barrier from spin_barrier.c, or
+ * pthread_barrier_wait with config.spin_barrier off.
+ *
+ * With config.affinity each thread is pinned to its CPU and its band of
+ * rows is bound to that CPU's NUMA node before the fill touches it.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ca_internal.h"
+#include "pool.h"
+#include "tiles.h"
+
+typedef struct {
+    ca_engine_t *engine;
+    pool_t *pool;
+    int generations;        /* work for the current step */
+    bool tracking;          /* activity tracking on */
+    tiles_t tiles;
+    long long *skipped;     /* tiles skipped per thread over all timesteps */
+    long long total;        /* tiles over all timesteps */
+} pthreads_t;
+
+
+/*
+ * Items [*start, *end) of [0, n) owned by thread rank.
+ */
+static void my_share(const pthreads_t *p, int n, int rank, int *start, int *end) {
+
+    int threads = p->pool->threads;
+    int base = n / threads;
+    int extra = n % threads;
+
+    *start = rank*base + (rank < extra ? rank : extra);
+    *end = *start + base + (rank < extra ? 1 : 0);
+
+}
+
+
+/*
+ * Rows [*start, *end) owned by thread rank.
+ */
+static void my_rows(const pthreads_t *p, int rank, int *start, int *end) {
+
+    my_share(p, p->engine->grid->rows, rank, start, end);
+    *start += 1;
+    *end += 1;
+
+}
+
+
+/*
+ * Run p->generations timesteps on this thread's rows.
+ */
+static void run(pool_t *pool, int rank, void *arg) {
+
+    pthreads_t *p = (pthreads_t*) arg;
+    ca_engine_t *engine = p->engine;
+    // read once: rank 0 may post the next step while others finish this one
+    int generations = p->generations;
+    int start, end;
+    my_rows(p, rank, &start, &end);
+
+    if (engine->bitpacked) {
+        uint64_t *src = engine->packed.cells;
+        uint64_t *dst = engine->packed.next;
+        for (int t = 0; t < generations; t++) {
+            bitgrid_step_rows(&engine->packed, src, dst, start, end);
+            pool_barrier(pool, rank);
+            uint64_t *tmp = src;
+            src = dst;
+            dst = tmp;
+        }
+    } else if (p->tracking) {
+        int *src = engine->grid->cells;
+        int *dst = engine->grid->next;
+        int parity = p->tiles.parity;
+        long long *skipped = &p->skipped[rank];
+        int tile_start, tile_end;
+        my_share(p, p->tiles.tile_rows, rank, &tile_start, &tile_end);
+        for (int t = 0; t < generations; t++) {
+            *skipped += tiles_step_rows(engine, &p->tiles, parity,
+                                        src, dst, tile_start, tile_end);
+            pool_barrier(pool, rank);
+            int *tmp = src;
+            src = dst;
+            dst = tmp;
+            parity ^= 1;
+        }
+    } else {
+        int *src = engine->grid->cells;
+        int *dst = engine->grid->next;
+        for (int t = 0; t < generations; t++) {
+            ca_sweep_rows(engine, src, dst, start, end);
+            pool_barrier(pool, rank);
+            int *tmp = src;
+            src = dst;
+            dst = tmp;
+        }
+    }
+
+}
+
+
+/*
+ * Fill the rows this thread steps (whole tile rows with tracking).
+ */
+static void fill(pool_t *pool, int rank, void *arg) {
+
+    pthreads_t *p = (pthreads_t*) arg;
+    ca_engine_t *engine = p->engine;
+    ca_grid_t *grid = engine->grid;
+    int start, end;
+
+    if (p->tracking) {
+        my_share(p, p->tiles.tile_rows, rank, &start, &end);
+        start = start * p->tiles.size + 1;
+        end = end * p->tiles.size + 1;
+        if (end > grid->rows + 1) {
+            end = grid->rows + 1;
+        }
+    } else {
+        my_rows(p, rank, &start, &end);
+    }
+    ca_bind_rows(engine, rank, start, end);
+    // an empty band fills nothing, except the ghost rows of an empty grid
+    if (start < end || (rank == 0 && grid->rows == 0)) {
+        ca_fill_rows(engine, start, end);
+    }
+    pool_barrier(pool, rank);
+
+}
+
+
+static int pthreads_init(ca_engine_t *engine) {
+
+    pthreads_t *p = (pthreads_t*) calloc(1, sizeof(pthreads_t));
+    p->engine = engine;
+
+    if (engine->config.tile_size > 0) {
+        if (engine->bitpacked) {
+            printf("ERROR: activity tracking needs the int, lut or simd kernels\n");
+            free(p);
+            return -1;
+        }
+        p->tracking = true;
+        tiles_init(&p->tiles, engine->grid->rows, engine->grid->cols,
+                   engine->config.tile_size);
+    }
+
+    p->pool = pool_create(engine->config.threads, engine->config.spin_barrier,
+                          engine->profile);
+    if (p->pool == NULL) {
+        free(p);
+        return -1;
+    }
+    ca_engine_affinity(engine, p->pool->threads, 0);
+    pool_pin(p->pool, &engine->affinity);
+    p->skipped = (long long*) calloc(p->pool->threads, sizeof(long long));
+    engine->state = p;
+    return 0;
+
+}
+
+
+static void pthreads_step(ca_engine_t *engine, int generations) {
+
+    pthreads_t *p = (pthreads_t*) engine->state;
+
+    p->generations = generations;
+    pool_run(p->pool, run, p);
+    if (p->tracking) {
+        p->total += (long long)generations * p->tiles.tile_rows * p->tiles.tile_cols;
+    }
+
+    // every thread swapped locally; catch the shared pointers up
+    if (generations % 2 == 1) {
+        p->tiles.parity ^= 1;
+        if (engine->bitpacked) {
+            bitgrid_swap(&engine->packed);
+        } else {
+            ca_grid_swap(engine->grid);
+        }
+    }
+
+}
+
+
+static void pthreads_randomize(ca_engine_t *engine) {
+
+    pthreads_t *p = (pthreads_t*) engine->state;
+    pool_run(p->pool, fill, p);
+
+}
+
+
+static void pthreads_describe(ca_engine_t *engine, char *buf, size_t len) {
+
+    pthreads_t *p = (pthreads_t*) engine->state;
+
+    int n = snprintf(buf, len, ", barrier: %s", engine->config.spin_barrier ? "spin" : "pthread");
+    if (p->tracking && n >= 0 && (size_t)n < len) {
+        long long skipped = 0;
+        for (int t = 0; t < p->pool->threads; t++) {
+            skipped += p->skipped[t];
+        }
+        tiles_describe(&p->tiles, skipped, p->total, buf + n, len - n);
+    }
+
+}
+
+
+static void pthreads_fini(ca_engine_t *engine) {
+
+    pthreads_t *p = (pthreads_t*) engine->state;
+
+    pool_free(p->pool);
+    free(p->skipped);
+    if (p->tracking) {
+        tiles_free(&p->tiles);
+    }
+    free(p);
+
+}
+
+
+const ca_backend_t ca_backend_pthreads = {
+    .name = "pthreads",
+    .kernels = CA_KERNEL_ALL,
+    .tiles = true,
+    .init = pthreads_init,
+    .step = pthreads_step,
+    .describe = pthreads_describe,
+    .randomize = pthreads_randomize,
+    .fini = pthreads_fini,
+};
@@ -0,0 +1,304 @@
+/*
+ * backend_serial.c
+ *
+ * Serial synchronous backend. The grid is updated one row at a time with the
+ * selected kernel, and swapped between the two generations after each
+ * timestep.
+ *
+ * Temporal blocking (config.block_depth > 0): the grid is cut into bands of
+ * rows and each band is advanced block_depth generations in a small scratch
+ * buffer before moving on to the next band, so the band stays in cache
+ * instead of streaming the whole grid from memory every timestep. Bands are
+ * sized to half the last level cache (at most 16 MB); a grid that stays in
+ * that cache anyway is stepped without blocking. Works with every kernel
+ * but bitpacked.
+ *
+ * Activity tracking (config.tile_size > 0): only the tiles that changed in
+ * the last generation and their neighbors are recomputed (tiles.c). Works
+ * with the int and row kernels.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ca_internal.h"
+#include "tiles.h"
+
+/*cache budget for a band when the cache sizes can't be read*/
+#ifndef BLOCK_CACHE_BYTES
+#define BLOCK_CACHE_BYTES (1 << 20)
+#endif
+
+/*most of a large last level cache belongs to the other cores*/
+#ifndef BLOCK_CACHE_MAX
+#define BLOCK_CACHE_MAX (16 << 20)
+#endif
+
+typedef struct {
+    tiles_t tiles;
+    long long skipped;      /* tiles skipped over all timesteps */
+    long long total;        /* tiles over all timesteps */
+} serial_state_t;
+
+
+/*
+ * Size of the last level cache, or -1 if it can't be read.
+ */
+static long llc_bytes() {
+
+    long bytes = -1;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (bytes <= 0) {
+        bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    }
+#endif
+    return bytes > 0 ? bytes : -1;
+
+}
+
+
+/*
+ * Rows per band for temporal blocking, or 0 if the grid is better stepped
+ * without it. A band (plus its halo, both generations) gets half the last
+ * level cache, leaving the rest to the grid rows streaming through, up to
+ * BLOCK_CACHE_MAX. A grid whose two generations take at most a quarter of
+ * the last level cache stays in it from one timestep to the next: there is
+ * no memory traffic for blocking to save, only the halo rows to recompute.
+ */
+static int block_band(const ca_engine_t *engine, int depth) {
+
+    const ca_grid_t *grid = engine->grid;
+    long llc = llc_bytes();
+    long row_bytes = (long)grid->max_cols * (long)sizeof(int);
+    if (llc > 0 && 2 * (long)grid->max_rows * row_bytes <= llc / 4) {
+        return 0;
+    }
+    long budget = llc < 0 ? BLOCK_CACHE_BYTES : llc / 2 < BLOCK_CACHE_MAX ? llc / 2 : BLOCK_CACHE_MAX;
+    long band = budget / (2 * row_bytes) - 2*depth;
+    return band > 4*depth ? (int)band : 4*depth;
+
+}
+
+
+/*
+ * Compute rows [r0, r1) of the next generation from src into dst, where src
+ * holds grid row i at its row i - src_first and dst at its row i - dst_first.
+ */
+static void sweep_band(const ca_engine_t *engine, const int *src, int src_first,
+                       int *dst, int dst_first, int r0, int r1) {
+
+    const int mc = engine->grid->max_cols;
+
+    for (int i = r0; i < r1; i++) {
+        const int *mid = src + (size_t)(i - src_first) * mc;
+        int *out = dst + (size_t)(i - dst_first) * mc;
+        if (ca_has_rows(engine)) {
+            ca_sweep_row(engine, mid - mc, mid, mid + mc, out, mc);
+            continue;
+        }
+        for (int j = 1; j < mc-1; j++) {
+            out[j] = engine->transition(&engine->rule, src, mc, i - src_first, j);
+        }
+    }
+
+}
+
+
+/*
+ * Advance with temporal blocking.
+ *
+ * Each pass advances every band of rows by d = min(block_depth, remaining)
+ * generations. The first generation of a band [band_start, band_end) reads
+ * grid->cells directly and covers d-1 halo rows on each side; after s
+ * generations only the rows at least s away from that range are still
+ * valid, so the computed range shrinks by one row per side per generation
+ * (the trapezoid). The generations in between alternate between two
+ * scratch buffers, and the last one, exactly the band, is written to
+ * grid->next. The fixed ghost rows stop the shrinking at the top and bottom
+ * of the grid. Halo rows are recomputed by the neighboring bands, which
+ * costs about d/band extra work in exchange for d generations per trip
+ * through memory.
+ */
+static void step_blocked(ca_engine_t *engine, int generations) {
+
+    ca_grid_t *grid = engine->grid;
+    const int mr = grid->max_rows, mc = grid->max_cols;
+    const size_t row_bytes = (size_t)mc * sizeof(int);
+
+    int depth = engine->config.block_depth;
+    if (depth > grid->rows) {
+        depth = grid->rows > 0 ? grid->rows : 1;
+    }
+
+    int band = block_band(engine, depth);
+    if (band == 0) {
+        for (int t = 0; t < generations; t++) {
+            ca_sweep_rows(engine, grid->cells, grid->next, 1, mr-1);
+            ca_grid_swap(grid);
+        }
+        return;
+    }
+
+    int scratch_rows = band + 2*depth + 2;
+    int *scratch[2];
+    for (int k = 0; k < 2; k++) {
+        scratch[k] = (int*) ca_alloc((size_t)scratch_rows * row_bytes);
+    }
+
+    int time = 0;
+    while (time < generations) {
+
+       int d = (generations - time < depth) ? generations - time : depth;
+
+       for (int band_start = 1; band_start < mr-1; band_start += band) {
+           int band_end = band_start + band;
+           if (band_end > mr-1) {
+               band_end = mr-1;
+           }
+
+           // scratch row 0 holds grid row lo; the ghost border the trapezoid
+           // reaches is copied in (the kernels never write it), the rest is
+           // computed
+           int lo = (band_start - d < 0) ? 0 : band_start - d;
+           int hi = (band_end + d > mr) ? mr : band_end + d;
+           for (int k = 0; k < 2; k++) {
+               for (int i = lo; i < hi; i++) {
+                   scratch[k][(size_t)(i - lo) * mc] = grid->cells[(size_t)i * mc];
+                   scratch[k][(size_t)(i - lo) * mc + mc-1] = grid->cells[(size_t)i * mc + mc-1];
+               }
+               if (lo == 0) {
+                   memcpy(scratch[k], grid->cells, row_bytes);
+               }
+               if (hi == mr) {
+                   memcpy(scratch[k] + (size_t)(mr-1 - lo) * mc,
+                          grid->cells + (size_t)(mr-1) * mc, row_bytes);
+               }
+           }
+
+           const int *src = grid->cells;
+           int src_first = 0;
+           for (int s = 0; s < d; s++) {
+               // rows still valid after this generation, clipped to the grid
+               int r0 = band_start - (d-1-s);
+               int r1 = band_end + (d-1-s);
+               if (r0 < 1) {
+                   r0 = 1;
+               }
+               if (r1 > mr-1) {
+                   r1 = mr-1;
+               }
+
+               int *dst = (s == d-1) ? grid->next : scratch[s % 2];
+               int dst_first = (s == d-1) ? 0 : lo;
+               sweep_band(engine, src, src_first, dst, dst_first, r0, r1);
+               src = dst;
+               src_first = dst_first;
+           }
+       }
+
+       ca_grid_swap(grid);
+       time += d;
+
+    }
+
+    free(scratch[0]);
+    free(scratch[1]);
+
+}
+
+
+static int serial_init(ca_engine_t *engine) {
+
+    if (engine->config.block_depth > 0) {
+        if (engine->bitpacked) {
+            printf("ERROR: temporal blocking is not available for the bitpacked kernel\n");
+            return -1;
+        }
+    }
+
+    if (engine->config.tile_size > 0) {
+        if (engine->bitpacked || engine->config.block_depth > 0) {
+            printf("ERROR: activity tracking needs the int, lut or simd kernels without temporal blocking\n");
+            return -1;
+        }
+        serial_state_t *s = (serial_state_t*) calloc(1, sizeof(serial_state_t));
+        tiles_init(&s->tiles, engine->grid->rows, engine->grid->cols,
+                   engine->config.tile_size);
+        engine->state = s;
+    }
+    return 0;
+
+}
+
+
+static void serial_step(ca_engine_t *engine, int generations) {
+
+    ca_grid_t *grid = engine->grid;
+
+    if (engine->bitpacked) {
+        for (int t = 0; t < generations; t++) {
+            bitgrid_step_rows(&engine->packed, engine->packed.cells,
+                              engine->packed.next, 1, grid->max_rows-1);
+            bitgrid_swap(&engine->packed);
+        }
+    } else if (engine->config.block_depth > 0) {
+        step_blocked(engine, generations);
+    } else if (engine->state != NULL) {
+        serial_state_t *s = (serial_state_t*) engine->state;
+        for (int t = 0; t < generations; t++) {
+            s->skipped += tiles_step_rows(engine, &s->tiles, s->tiles.parity,
+                                          grid->cells, grid->next,
+                                          0, s->tiles.tile_rows);
+            s->total += (long long)s->tiles.tile_rows * s->tiles.tile_cols;
+            s->tiles.parity ^= 1;
+            ca_grid_swap(grid);
+        }
+    } else {
+        for (int t = 0; t < generations; t++) {
+            ca_sweep_rows(engine, grid->cells, grid->next, 1, grid->max_rows-1);
+            ca_grid_swap(grid);
+        }
+    }
+
+}
+
+
+static void serial_describe(ca_engine_t *engine, char *buf, size_t len) {
+
+    if (engine->config.block_depth > 0) {
+        snprintf(buf, len, ", block depth: %d%s", engine->config.block_depth,
+                 block_band(engine, engine->config.block_depth) == 0 ? " (off, grid fits in cache)" : "");
+    }
+    if (engine->state != NULL) {
+        serial_state_t *s = (serial_state_t*) engine->state;
+        tiles_describe(&s->tiles, s->skipped, s->total, buf, len);
+    }
+
+}
+
+
+static void serial_fini(ca_engine_t *engine) {
+
+    serial_state_t *s = (serial_state_t*) engine->state;
+    if (s != NULL) {
+        tiles_free(&s->tiles);
+        free(s);
+    }
+
+}
+
+
+const ca_backend_t ca_backend_serial = {
+    .name = "serial",
+    .kernels = CA_KERNEL_ALL,
+    .tiles = true,
+    .init = serial_init,
+    .step = serial_step,
+    .describe = serial_describe,
+    .fini = serial_fini,
+};
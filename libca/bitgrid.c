@@ -0,0 +1,168 @@
+/*
+ * bitgrid.c
+ *
+ * Word-parallel Game of Life step on a bit-packed cellspace. See bitgrid.h
+ * for the layout.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitgrid.h"
+
+
+/*
+ * Allocate both generations of a rows x cols packed grid (ghost border
+ * included) and build the interior column mask.
+ */
+void bitgrid_init(bitgrid_t *g, int rows, int cols) {
+
+    g->rows = rows;
+    g->cols = cols;
+    g->words = (cols + 63) / 64;
+
+    g->cells = (uint64_t*) calloc((size_t)rows * g->words, sizeof(uint64_t));
+    g->next = (uint64_t*) calloc((size_t)rows * g->words, sizeof(uint64_t));
+    g->mask = (uint64_t*) calloc(g->words, sizeof(uint64_t));
+    if (g->cells == NULL || g->next == NULL || g->mask == NULL) {
+        printf("ERROR: could not allocate bit-packed grid\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // only columns [1, cols-2] are updated, the rest is ghost border
+    for (int y = 1; y < cols-1; y++) {
+        g->mask[y / 64] |= (uint64_t)1 << (y % 64);
+    }
+
+}
+
+
+void bitgrid_free(bitgrid_t *g) {
+
+    free(g->cells);
+    free(g->next);
+    free(g->mask);
+
+}
+
+
+/*
+ * Pack an int cellspace into both generations. The ghost border has to be
+ * present in each buffer since border words are never rewritten by a step.
+ */
+void bitgrid_pack(bitgrid_t *g, const int *src) {
+
+    memset(g->cells, 0, (size_t)g->rows * g->words * sizeof(uint64_t));
+    for (int x = 0; x < g->rows; x++) {
+        uint64_t *row = g->cells + (size_t)x*g->words;
+        for (int y = 0; y < g->cols; y++) {
+            if (*(src + (size_t)x*g->cols + y) == 1) {
+                row[y / 64] |= (uint64_t)1 << (y % 64);
+            }
+        }
+    }
+    memcpy(g->next, g->cells, (size_t)g->rows * g->words * sizeof(uint64_t));
+
+}
+
+
+/*
+ * Unpack the current generation back into an int cellspace.
+ */
+void bitgrid_unpack(const bitgrid_t *g, int *dst) {
+
+    for (int x = 0; x < g->rows; x++) {
+        const uint64_t *row = g->cells + (size_t)x*g->words;
+        for (int y = 0; y < g->cols; y++) {
+            *(dst + (size_t)x*g->cols + y) = (row[y / 64] >> (y % 64)) & 1;
+        }
+    }
+
+}
+
+
+/*
+ * Sum of three one-bit inputs per lane: *s gets the ones bit and *c the
+ * twos bit.
+ */
+static inline void full_add(uint64_t a, uint64_t b, uint64_t c,
+                            uint64_t *s, uint64_t *cy) {
+
+    uint64_t t = a ^ b;
+    *s = t ^ c;
+    *cy = (a & b) | (t & c);
+
+}
+
+
+/*
+ * Compute the next generation of rows [start, end) from src into dst.
+ *
+ * For every word the eight neighbors are formed by shifting the rows above,
+ * at and below by one column, pulling the carried bit in from the adjacent
+ * word. The neighbor count is then accumulated in bit-sliced form:
+ *   count = s0 + 2*(c_top + c_mid + c_bot + c0)
+ * which is enough to tell 2 and 3 apart from everything else (a count of 8
+ * wraps to 0, which is dead either way).
+ */
+void bitgrid_step_rows(const bitgrid_t *g, const uint64_t *src, uint64_t *dst,
+                       int start, int end) {
+
+    const int words = g->words;
+
+    for (int x = start; x < end; x++) {
+        const uint64_t *up = src + (size_t)(x-1)*words;
+        const uint64_t *mid = src + (size_t)x*words;
+        const uint64_t *down = src + (size_t)(x+1)*words;
+        uint64_t *out = dst + (size_t)x*words;
+
+        for (int w = 0; w < words; w++) {
+            uint64_t u = up[w], m = mid[w], d = down[w];
+            uint64_t u_prev = w > 0 ? up[w-1] : 0;
+            uint64_t m_prev = w > 0 ? mid[w-1] : 0;
+            uint64_t d_prev = w > 0 ? down[w-1] : 0;
+            uint64_t u_next = w < words-1 ? up[w+1] : 0;
+            uint64_t m_next = w < words-1 ? mid[w+1] : 0;
+            uint64_t d_next = w < words-1 ? down[w+1] : 0;
+
+            // west (column - 1) and east (column + 1) neighbors
+            uint64_t uw = (u << 1) | (u_prev >> 63);
+            uint64_t ue = (u >> 1) | (u_next << 63);
+            uint64_t mw = (m << 1) | (m_prev >> 63);
+            uint64_t me = (m >> 1) | (m_next << 63);
+            uint64_t dw = (d << 1) | (d_prev >> 63);
+            uint64_t de = (d >> 1) | (d_next << 63);
+
+            uint64_t s_top, c_top, s_bot, c_bot, s0, c0, t1, t2;
+            full_add(uw, u, ue, &s_top, &c_top);
+            full_add(dw, d, de, &s_bot, &c_bot);
+            uint64_t s_mid = mw ^ me;
+            uint64_t c_mid = mw & me;
+
+            full_add(s_top, s_mid, s_bot, &s0, &c0);
+            full_add(c_top, c_mid, c_bot, &t1, &t2);
+            uint64_t s1 = t1 ^ c0;
+            uint64_t s2 = t2 | (t1 & c0);
+
+            // alive next if count == 3, or count == 2 and alive now
+            uint64_t alive = s1 & ~s2 & (s0 | m);
+            out[w] = (alive & g->mask[w]) | (m & ~g->mask[w]);
+        }
+    }
+
+}
+
+
+/*
+ * Make the freshly computed generation current.
+ */
+void bitgrid_swap(bitgrid_t *g) {
+
+    uint64_t *tmp = g->cells;
+    g->cells = g->next;
+    g->next = tmp;
+
+}
@@ -0,0 +1,36 @@
+/*
+ * bitgrid.h
+ *
+ * Bit-packed cellspace for the synchronous model. Each row of MAX_COLS cells
+ * (ghost border included) is stored in ceil(MAX_COLS/64) uint64_t words, with
+ * column c held in bit (c % 64) of word (c / 64). A step evaluates 64 cells
+ * at once by summing the eight shifted neighbor words with bitwise adders
+ * instead of calling transition() per cell.
+ *
+ * The ghost border keeps the same meaning as in the int grid: border cells
+ * are never updated, so the packed step only writes interior columns.
+ */
+
+#ifndef BITGRID_H
+#define BITGRID_H
+
+#include <stdint.h>
+
+typedef struct {
+    int rows;           /* rows including the ghost border */
+    int cols;           /* cols including the ghost border */
+    int words;          /* uint64_t words per row */
+    uint64_t *cells;    /* current generation */
+    uint64_t *next;     /* buffer for the next generation */
+    uint64_t *mask;     /* per-word mask of interior (non-border) columns */
+} bitgrid_t;
+
+void bitgrid_init(bitgrid_t *g, int rows, int cols);
+void bitgrid_free(bitgrid_t *g);
+void bitgrid_pack(bitgrid_t *g, const int *src);
+void bitgrid_unpack(const bitgrid_t *g, int *dst);
+void bitgrid_step_rows(const bitgrid_t *g, const uint64_t *src, uint64_t *dst,
+                       int start, int end);
+void bitgrid_swap(bitgrid_t *g);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * ca.h
+ *
+ * libca: the cellular automata engine shared by the ca_reg and ca_random
+ * programs.
+ *
+ * A ca_grid_t owns the cellspace: ROWS x COLS interior cells surrounded by a
+ * one cell ghost border of live cells that is never updated, stored as one
+ * int per cell in two aligned buffers (current and next generation).
+ *
+ * A ca_engine_t steps a grid with one of the backends below, selected by
+ * name at runtime:
+ *
+ *   serial               synchronous, one thread (kernels, temporal blocking)
+ *   pthreads             synchronous, persistent pool of worker threads
+ *   omp                  synchronous, OpenMP parallel for over rows
+ *   mpi                  synchronous, distributed over MPI ranks (libca_mpi)
+ *   hashlife             synchronous, memoized quadtree for very long runs
+ *   rand_ind             asynchronous, one random cell per timestep
+ *   rand_ind_pthreads    rand_ind on worker threads, alternating strips
+ *   rand_order           asynchronous, every cell once per timestep in random order
+ *   rand_order_pthreads  rand_order with worker threads
+ *
+ * Typical use:
+ *
+ *      ca_grid_t *grid = ca_grid_create(rows, cols);
+ *      ca_config_t config;
+ *      ca_config_default(&config);      // config.seed from the clock
+ *      ca_grid_randomize(grid, config.seed);
+ *      ca_engine_t *engine = ca_engine_create("serial", grid, &config);
+ *      ca_engine_step(engine, timesteps);
+ *      ca_engine_sync(engine);          // grid->cells holds the result
+ *      ca_engine_free(engine);
+ *      ca_grid_free(grid);
+ *
+ * Runs are reproducible: the initial cellspace and the update orders of the
+ * asynchronous backends depend only on config.seed (prng.h), not on the
+ * thread or rank count.
+ *
+ * With a grid from ca_grid_alloc() and config.randomize set,
+ * ca_engine_create() fills the grid itself, on the backend's own threads
+ * and with the rows split as in a step, so each page is first touched (and
+ * placed on the NUMA node of) the thread that will update it. The result
+ * is the same as ca_grid_randomize(grid, config.seed). The mpi backend
+ * fills each rank's block on that rank; rank 0's grid only holds the
+ * cellspace after ca_engine_sync().
+ *
+ * With config.pattern set to an RLE or plaintext pattern file, the grid
+ * starts out dead except for the pattern (pattern.h), placed at
+ * config.pattern_row/pattern_col or centered. The fill is parallel like
+ * config.randomize: each thread or rank parses the file into its own rows.
+ * If config.rule is NULL the rule comes from the RLE header.
+ *
+ * ca_engine_checkpoint() saves the current generation, timestep and random
+ * number state to a file (checkpoint.h). With config.restart set to such a
+ * file, ca_engine_create() fills the grid from it instead of the seed, on
+ * the backend's threads like config.randomize, and the run continues
+ * exactly where it was saved: ca_engine_timestep() starts at the saved
+ * timestep. The grid size and rule have to match, and an asynchronous
+ * backend only resumes its own checkpoints; the seed and, if config.rule
+ * is NULL, the rule come from the file. The mpi backend restarts from
+ * these files too, and writes them in parallel with ca_mpi_snapshot()
+ * (ca_mpi.h).
+ *
+ * config.affinity pins the backend's threads (or the calling thread, for
+ * the single-threaded backends) to CPUs, see affinity.h, and binds each
+ * thread's band of rows to the memory of its NUMA node.
+ * ca_engine_placement() lists where every thread ended up. The mpi backend
+ * numbers the slots per machine, so ranks sharing a node get disjoint CPUs
+ * (run with mpirun --bind-to none to let it place them).
+ *
+ * Built with make PROFILE=1, every engine times each of its threads by phase
+ * (init, compute, barrier, comm, output; see profile.h), and
+ * ca_engine_profile() prints the totals with the load imbalance between the
+ * threads. Built without, it prints nothing and costs nothing.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#ifndef CA_H
+#define CA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* alignment of the cell buffers, one cache line / one AVX-512 vector */
+#define CA_ALIGN 64
+
+typedef struct {
+    int rows;           /* interior rows */
+    int cols;           /* interior cols */
+    int max_rows;       /* rows + ghost border */
+    int max_cols;       /* cols + ghost border, also the row stride */
+    int *cells;         /* current generation, NULL for a shape-only grid */
+    int *next;          /* next generation */
+} ca_grid_t;
+
+typedef struct {
+    const char *kernel; /* int, lut, bitpacked, simd, avx512, avx2, sse2, scalar */
+    const char *rule;   /* rule string, e.g. "B36/S23" or "B2/S/3"; NULL = B3/S23 */
+    int threads;        /* worker threads for the threaded backends */
+    int block_depth;    /* serial: generations per temporal block, 0 = off */
+    int tile_size;      /* serial, pthreads: skip quiescent tiles of this edge, 0 = off */
+    bool spin_barrier;  /* pthreads: spin barrier instead of pthread_barrier_t */
+    int cache_mb;       /* hashlife: memo cache budget in MB, 0 = default */
+    bool halo;          /* mpi: halo exchange instead of allgather */
+    bool decomp_2d;     /* mpi: 2D process grid (implies halo) */
+    bool overlap;       /* mpi: overlap halo exchange with interior updates */
+    uint64_t seed;      /* initial cellspace and asynchronous update orders */
+    bool randomize;     /* fill the grid from seed in ca_engine_create(), in parallel */
+    const char *restart; /* checkpoint to start from instead of the seed */
+    const char *pattern; /* RLE or plaintext pattern to start from instead of the seed */
+    int pattern_row;    /* interior row of the pattern's top left cell, -1 = centered */
+    int pattern_col;    /* interior col of the pattern's top left cell, -1 = centered */
+    const char *affinity; /* pin threads: "compact", "scatter" or a CPU list such as
+                             "0,2,4-7"; NULL leaves placement to the OS */
+} ca_config_t;
+
+typedef struct ca_engine ca_engine_t;
+typedef struct ca_backend ca_backend_t;
+typedef struct ca_ensemble ca_ensemble_t;
+typedef struct ca_frames ca_frames_t;
+
+/* members of a ca_ensemble_t, one per bit of a uint64_t */
+#define CA_ENSEMBLE_MAX 64
+
+/* grid */
+ca_grid_t *ca_grid_create(int rows, int cols);
+ca_grid_t *ca_grid_shape(int rows, int cols);
+ca_grid_t *ca_grid_alloc(int rows, int cols);
+void ca_grid_free(ca_grid_t *grid);
+void ca_grid_randomize(ca_grid_t *grid, uint64_t seed);
+void ca_grid_randomize_rows(ca_grid_t *grid, uint64_t seed, int start, int end);
+void ca_grid_set_border(ca_grid_t *grid);
+void ca_grid_print(const ca_grid_t *grid, int timestep);
+
+/* engine */
+void ca_config_default(ca_config_t *config);
+ca_engine_t *ca_engine_create(const char *backend, ca_grid_t *grid,
+                              const ca_config_t *config);
+void ca_engine_step(ca_engine_t *engine, int generations);
+void ca_engine_sync(ca_engine_t *engine);
+void ca_engine_describe(ca_engine_t *engine, char *buf, size_t len);
+void ca_engine_placement(const ca_engine_t *engine, char *buf, size_t len);
+int ca_engine_checkpoint(ca_engine_t *engine, const char *path);
+int ca_engine_timestep(const ca_engine_t *engine);
+void ca_engine_profile(ca_engine_t *engine);
+void ca_engine_free(ca_engine_t *engine);
+
+/* ensemble: up to 64 independent grids of one size, bit-sliced (ensemble.c) */
+ca_ensemble_t *ca_ensemble_create(int rows, int cols, int members,
+                                  const ca_config_t *config);
+void ca_ensemble_randomize(ca_ensemble_t *e, int member, uint64_t seed, double density);
+void ca_ensemble_step(ca_ensemble_t *e, int generations);
+void ca_ensemble_population(const ca_ensemble_t *e, long long *population);
+void ca_ensemble_extract(const ca_ensemble_t *e, int member, ca_grid_t *grid);
+void ca_ensemble_free(ca_ensemble_t *e);
+
+/* frames: images of the grid written by a background thread (frames.c) */
+ca_frames_t *ca_frames_open(const char *path, const ca_engine_t *engine, int depth);
+int ca_frames_write(ca_frames_t *f, const ca_grid_t *grid, int timestep);
+int ca_frames_close(ca_frames_t *f);
+
+/* backends */
+int ca_backend_register(const ca_backend_t *backend);
+const ca_backend_t *ca_backend_find(const char *name);
+
+#endif
@@ -0,0 +1,577 @@
+/*
+ * ca_engine.c
+ *
+ * Backend registry, kernel selection and the step API. See ca.h.
+ *
+ * Acknowledgements:
+ * Game of Life transitions - https://natureofcode.com/book/chapter-7-cellular-automata/
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ca_internal.h"
+
+#define MAX_BACKENDS 16
+
+/* built-in backends first, registered ones after; the first NULL ends the table */
+static const ca_backend_t *backends[MAX_BACKENDS + 1] = {
+    &ca_backend_serial,
+    &ca_backend_pthreads,
+    &ca_backend_omp,
+    &ca_backend_hashlife,
+    &ca_backend_rand_ind,
+    &ca_backend_rand_ind_pthreads,
+    &ca_backend_rand_order,
+    &ca_backend_rand_order_pthreads,
+};
+
+
+/*
+ * Add a backend that isn't built into libca (e.g. mpi from libca_mpi).
+ * Returns 0 on success.
+ */
+int ca_backend_register(const ca_backend_t *backend) {
+
+    if (ca_backend_find(backend->name) != NULL) {
+        return 0;
+    }
+    int n = 0;
+    while (backends[n] != NULL) {
+        n++;
+    }
+    if (n == MAX_BACKENDS) {
+        return -1;
+    }
+    backends[n] = backend;
+    return 0;
+
+}
+
+
+const ca_backend_t *ca_backend_find(const char *name) {
+
+    for (int i = 0; backends[i] != NULL; i++) {
+        if (strcmp(backends[i]->name, name) == 0) {
+            return backends[i];
+        }
+    }
+    return NULL;
+
+}
+
+
+void ca_config_default(ca_config_t *config) {
+
+    memset(config, 0, sizeof(ca_config_t));
+    config->kernel = "int";
+    config->threads = 1;
+    config->spin_barrier = true;
+    config->seed = (uint64_t)time(0);
+    config->pattern_row = -1;
+    config->pattern_col = -1;
+
+}
+
+
+/*
+ * Returns true if a cell (x,y) of matrix p (row stride stride) would
+ * survive to the next transition.
+ */
+bool ca_transition(const int *p, int stride, int x, int y) {
+
+    int livingNeighbors = 0;
+    for (int nRows = x - 1; nRows <= x + 1; nRows++) {     //Count Living Neighbors
+        for (int nCols = y - 1; nCols <= y + 1; nCols++) {
+            if (*(p + nRows*stride + nCols) == 1) {
+                livingNeighbors++;
+            }
+        }
+    }
+
+    //subtract current cell
+    livingNeighbors -= *(p + x*stride + y);
+
+    if (*(p + x*stride + y) == 1) {           //Decide if cell will live or perish
+        return (livingNeighbors == 2 || livingNeighbors == 3);
+    } else {
+        return (livingNeighbors == 3);
+    }
+
+}
+
+
+/*
+ * Per cell evaluator for B3/S23 with the cell_kernel_t signature.
+ */
+int ca_cell(const ca_rule_t *rule, const int *p, int stride, int x, int y) {
+
+    (void)rule;
+    return ca_transition(p, stride, x, y) ? 1 : 0;
+
+}
+
+
+/*
+ * True if the engine updates whole rows: a row kernel, or a custom rule.
+ */
+bool ca_has_rows(const ca_engine_t *engine) {
+
+    return engine->row_kernel != NULL || engine->custom_rule;
+
+}
+
+
+/*
+ * Next generation of columns [1, cols-2] of one row, for engines with
+ * ca_has_rows().
+ */
+void ca_sweep_row(const ca_engine_t *engine, const int *up, const int *mid,
+                  const int *down, int *out, int cols) {
+
+    if (engine->row_kernel != NULL) {
+        engine->row_kernel(up, mid, down, out, cols);
+    } else {
+        rule_row(&engine->rule, up, mid, down, out, cols);
+    }
+
+}
+
+
+/*
+ * Compute rows [start, end) of the next generation from src into dst with
+ * the engine's int or row kernel.
+ */
+void ca_sweep_rows(const ca_engine_t *engine, const int *src, int *dst,
+                   int start, int end) {
+
+    const int mc = engine->grid->max_cols;
+
+    for (int i = start; i < end; i++) {
+        // vectorized kernels update the whole row at once
+        if (ca_has_rows(engine)) {
+            ca_sweep_row(engine, src + (i-1)*mc, src + i*mc, src + (i+1)*mc,
+                         dst + i*mc, mc);
+            continue;
+        }
+        for (int j = 1; j < mc-1; j++) {
+            *(dst + i*mc + j) = engine->transition(&engine->rule, src, mc, i, j);
+        }
+    }
+
+}
+
+
+/*
+ * Resolve the kernel name into engine->row_kernel/transition/bitpacked.
+ * Returns the CA_KERNEL_* classes it can run as, or 0 if the name is
+ * unknown or unsupported by the CPU.
+ */
+static unsigned select_kernel(ca_engine_t *engine, const char *name) {
+
+    if (name == NULL || strcmp(name, "int") == 0) {
+        engine->kernel_name = "int";
+        return CA_KERNEL_INT;
+    }
+    if (strcmp(name, "lut") == 0) {
+        // a row kernel, with a per cell form for the backends without rows
+        engine->kernel_name = "lut";
+        engine->row_kernel = lut_row_kernel();
+        engine->transition = lut_transition;
+        return CA_KERNEL_ROW | CA_KERNEL_INT;
+    }
+    if (strcmp(name, "bitpacked") == 0) {
+        engine->kernel_name = "bitpacked";
+        engine->bitpacked = true;
+        return CA_KERNEL_BITPACKED;
+    }
+    engine->row_kernel = simd_select(name, &engine->kernel_name);
+    return engine->row_kernel != NULL ? CA_KERNEL_ROW : 0;
+
+}
+
+
+/*
+ * Create an engine stepping grid with the named backend. The grid has to
+ * hold the initial state already, unless config.randomize, config.restart
+ * or config.pattern has it filled here. Returns NULL (after printing why) if the
+ * backend or kernel is unknown or the backend can't run this configuration.
+ */
+ca_engine_t *ca_engine_create(const char *backend, ca_grid_t *grid,
+                              const ca_config_t *config) {
+
+    const ca_backend_t *b = ca_backend_find(backend);
+    if (b == NULL) {
+        printf("ERROR: unknown backend '%s'\n", backend);
+        return NULL;
+    }
+
+    ca_engine_t *engine = (ca_engine_t*) calloc(1, sizeof(ca_engine_t));
+    engine->backend = b;
+    engine->grid = grid;
+    if (config != NULL) {
+        engine->config = *config;
+    } else {
+        ca_config_default(&engine->config);
+    }
+
+    // a restart continues the saved run, with its seed and by default its rule
+    checkpoint_header_t header;
+    if (engine->config.restart != NULL) {
+        if (checkpoint_header(engine->config.restart, &header) != 0) {
+            free(engine);
+            return NULL;
+        }
+        engine->config.seed = header.seed;
+        if (engine->config.rule == NULL) {
+            engine->config.rule = header.rule;
+        }
+    }
+    // so does a pattern with a rule in its header
+    char pattern_rule_name[RULE_NAME_LEN];
+    if (engine->config.pattern != NULL) {
+        if (engine->config.restart != NULL) {
+            printf("ERROR: a run starts from a pattern or from a checkpoint, not both\n");
+            free(engine);
+            return NULL;
+        }
+        if (pattern_rule(engine->config.pattern, pattern_rule_name, sizeof(pattern_rule_name)) != 0) {
+            free(engine);
+            return NULL;
+        }
+        if (engine->config.rule == NULL && pattern_rule_name[0] != '\0') {
+            engine->config.rule = pattern_rule_name;
+        }
+    }
+    prng_seed(&engine->prng, engine->config.seed, 0);
+
+    const char *rule = engine->config.rule != NULL ? engine->config.rule : "B3/S23";
+    if (rule_parse(&engine->rule, rule) != 0) {
+        printf("ERROR: invalid rule '%s', expected e.g. B3/S23 or B2/S/3\n", rule);
+        free(engine);
+        return NULL;
+    }
+    if (engine->config.rule == header.rule || engine->config.rule == pattern_rule_name) {
+        engine->config.rule = engine->rule.name;
+    }
+    engine->custom_rule = !rule_is_life(&engine->rule);
+
+    engine->transition = ca_cell;
+    unsigned kernel;
+    if (engine->custom_rule) {
+        // the other kernels hard-wire B3/S23
+        if (engine->config.kernel != NULL && strcmp(engine->config.kernel, "int") != 0) {
+            printf("ERROR: the %s kernel only implements B3/S23, use int for rule %s\n",
+                   engine->config.kernel, engine->rule.name);
+            free(engine);
+            return NULL;
+        }
+        engine->kernel_name = "int";
+        engine->row_kernel = engine->rule.row;
+        engine->transition = rule_transition;
+        kernel = CA_KERNEL_INT | CA_KERNEL_ROW;
+    } else {
+        kernel = select_kernel(engine, engine->config.kernel);
+    }
+    if (kernel == 0) {
+        printf("ERROR: kernel '%s' is unknown or not supported by this CPU\n",
+               engine->config.kernel);
+        free(engine);
+        return NULL;
+    }
+    if ((b->kernels & kernel) == 0) {
+        printf("ERROR: backend '%s' does not support the %s kernel\n",
+               b->name, engine->kernel_name);
+        free(engine);
+        return NULL;
+    }
+    if ((b->kernels & CA_KERNEL_ROW) == 0) {
+        engine->row_kernel = NULL;
+    }
+
+    if (engine->config.tile_size > 0 && !b->tiles) {
+        printf("ERROR: backend '%s' does not support activity tracking\n", b->name);
+        free(engine);
+        return NULL;
+    }
+
+#ifdef CA_PROFILE
+    engine->profile = profile_create();
+#endif
+    PROFILE_SWITCH(engine->profile, 0, PROFILE_INIT);
+
+    // the calling thread does the serial fill and steps the single-threaded
+    // backends; the others place their threads in init
+    if (engine->config.affinity != NULL) {
+        if (affinity_init(&engine->affinity, engine->config.affinity, 1, 0) != 0) {
+            profile_free(engine->profile);
+            free(engine);
+            return NULL;
+        }
+        if (b->randomize == NULL) {
+            affinity_pin(&engine->affinity, 0);
+        }
+    }
+
+    checkpoint_t restart;
+    if (engine->config.restart != NULL) {
+        if (checkpoint_open(&restart, engine->config.restart, engine) != 0) {
+            affinity_free(&engine->affinity);
+            profile_free(engine->profile);
+            free(engine);
+            return NULL;
+        }
+        engine->restart = &restart;
+    }
+    pattern_t pattern;
+    if (engine->config.pattern != NULL) {
+        if (pattern_open(&pattern, engine->config.pattern, engine) != 0) {
+            affinity_free(&engine->affinity);
+            profile_free(engine->profile);
+            free(engine);
+            return NULL;
+        }
+        engine->pattern = &pattern;
+    }
+
+    // backends without threads of their own get the serial fill
+    bool fill = engine->config.randomize || engine->restart != NULL || engine->pattern != NULL;
+    if (fill && b->randomize == NULL && grid->cells != NULL) {
+        ca_fill_rows(engine, 1, grid->rows + 1);
+    }
+
+    if (engine->bitpacked) {
+        bitgrid_init(&engine->packed, grid->max_rows, grid->max_cols);
+    }
+
+    if (b->init(engine) != 0) {
+        if (engine->bitpacked) {
+            bitgrid_free(&engine->packed);
+        }
+        if (engine->restart != NULL) {
+            checkpoint_close(&restart);
+        }
+        if (engine->pattern != NULL) {
+            pattern_close(&pattern);
+        }
+        affinity_free(&engine->affinity);
+        profile_free(engine->profile);
+        free(engine);
+        return NULL;
+    }
+
+    if (fill && b->randomize != NULL) {
+        b->randomize(engine);
+    }
+    if (engine->bitpacked) {
+        bitgrid_pack(&engine->packed, grid->cells);
+    }
+    if (engine->restart != NULL) {
+        engine->timestep = (int)restart.header->timestep;
+        memcpy(engine->prng.s, restart.header->prng, sizeof(engine->prng.s));
+        engine->counter = restart.header->counter;
+        checkpoint_close(&restart);
+        engine->restart = NULL;
+    }
+    if (engine->pattern != NULL) {
+        pattern_close(&pattern);
+        engine->pattern = NULL;
+    }
+    PROFILE_SWITCH(engine->profile, 0, PROFILE_IDLE);
+    return engine;
+
+}
+
+
+/*
+ * Initial state of interior rows [start, end) and the ghost rows next to
+ * them: from the checkpoint being restarted or the pattern, otherwise from
+ * config.seed.
+ */
+void ca_fill_rows(ca_engine_t *engine, int start, int end) {
+
+    if (engine->restart != NULL) {
+        checkpoint_rows(engine->restart, engine->grid, start, end);
+    } else if (engine->pattern != NULL) {
+        pattern_rows(engine->pattern, engine->grid, start, end);
+    } else {
+        ca_grid_randomize_rows(engine->grid, engine->config.seed, start, end);
+    }
+
+}
+
+
+/*
+ * Place threads threads for config.affinity, thread t in slot first + t.
+ * Does nothing with config.affinity unset; the policy itself was checked
+ * by ca_engine_create().
+ */
+void ca_engine_affinity(ca_engine_t *engine, int threads, int first) {
+
+    if (engine->config.affinity == NULL) {
+        return;
+    }
+    affinity_free(&engine->affinity);
+    affinity_init(&engine->affinity, engine->config.affinity, threads, first);
+
+}
+
+
+/*
+ * Bind rows [start, end) of the grid's buffers (and of the packed buffers)
+ * to the NUMA node of thread rank, before they are first touched.
+ */
+void ca_bind_rows(ca_engine_t *engine, int rank, int start, int end) {
+
+    const ca_grid_t *grid = engine->grid;
+    const affinity_t *a = &engine->affinity;
+
+    if (a->threads == 0 || end <= start) {
+        return;
+    }
+    size_t offset = (size_t)start * grid->max_cols;
+    size_t bytes = (size_t)(end - start) * grid->max_cols * sizeof(int);
+    if (grid->cells != NULL) {
+        affinity_bind(a, rank, grid->cells + offset, bytes);
+        affinity_bind(a, rank, grid->next + offset, bytes);
+    }
+    if (engine->bitpacked) {
+        offset = (size_t)start * engine->packed.words;
+        bytes = (size_t)(end - start) * engine->packed.words * sizeof(uint64_t);
+        affinity_bind(a, rank, engine->packed.cells + offset, bytes);
+        affinity_bind(a, rank, engine->packed.next + offset, bytes);
+    }
+
+}
+
+
+/*
+ * Advance the grid by the given number of generations (timesteps).
+ */
+void ca_engine_step(ca_engine_t *engine, int generations) {
+
+    if (generations <= 0) {
+        return;
+    }
+    PROFILE_BEGIN(engine->profile, 0, PROFILE_COMPUTE);
+    engine->backend->step(engine, generations);
+    engine->timestep += generations;
+    PROFILE_END(engine->profile, 0);
+
+}
+
+
+/*
+ * Bring grid->cells up to date with the engine's current generation.
+ */
+void ca_engine_sync(ca_engine_t *engine) {
+
+    PROFILE_BEGIN(engine->profile, 0, PROFILE_COMPUTE);
+    if (engine->bitpacked) {
+        bitgrid_unpack(&engine->packed, engine->grid->cells);
+    }
+    if (engine->backend->sync != NULL) {
+        engine->backend->sync(engine);
+    }
+    PROFILE_END(engine->profile, 0);
+
+}
+
+
+/*
+ * Short description of the engine for timing lines, e.g.
+ * "kernel: avx512, block depth: 4".
+ */
+void ca_engine_describe(ca_engine_t *engine, char *buf, size_t len) {
+
+    if (len == 0) {
+        return;
+    }
+    snprintf(buf, len, "kernel: %s", engine->kernel_name);
+    size_t n = strlen(buf);
+    if (engine->custom_rule) {
+        snprintf(buf + n, len - n, ", rule: %s (%s)", engine->rule.name,
+                 engine->rule.row != NULL ? "specialized" : "table");
+        n = strlen(buf);
+    }
+    if (engine->backend->describe != NULL && n + 1 < len) {
+        engine->backend->describe(engine, buf + n, len - n);
+        n = strlen(buf);
+    }
+    if (engine->config.affinity != NULL) {
+        snprintf(buf + n, len - n, ", affinity: %s", engine->config.affinity);
+        n = strlen(buf);
+    }
+    if (engine->config.pattern != NULL) {
+        snprintf(buf + n, len - n, ", pattern: %s", engine->config.pattern);
+        n = strlen(buf);
+    }
+    // a pattern replaces the random fill, only the random orders still use the seed
+    if (engine->config.pattern == NULL || engine->backend->random) {
+        snprintf(buf + n, len - n, ", seed: %llu", (unsigned long long)engine->config.seed);
+    }
+
+}
+
+
+/*
+ * Where each thread of the engine runs, one line per thread, e.g.
+ * "thread 0: cpu 0, node 0". Empty without config.affinity.
+ */
+void ca_engine_placement(const ca_engine_t *engine, char *buf, size_t len) {
+
+    affinity_map(&engine->affinity, buf, len);
+
+}
+
+
+int ca_engine_timestep(const ca_engine_t *engine) {
+
+    return engine->timestep;
+
+}
+
+
+/*
+ * Print the time each thread of the engine spent in each phase so far (see
+ * profile.h), with the load imbalance between them. Programs built with MPI
+ * call it on every rank, and rank 0 prints a row per rank. Does nothing
+ * unless libca was built with make PROFILE=1.
+ */
+void ca_engine_profile(ca_engine_t *engine) {
+
+    if (engine->profile == NULL) {
+        return;
+    }
+    if (engine->backend->profile != NULL) {
+        engine->backend->profile(engine);
+        return;
+    }
+    double *totals = (double*) malloc(engine->profile->threads * PROFILE_PHASES * sizeof(double));
+    profile_totals(engine->profile, totals);
+    profile_print(totals, engine->profile->threads, "thread");
+    free(totals);
+
+}
+
+
+void ca_engine_free(ca_engine_t *engine) {
+
+    if (engine == NULL) {
+        return;
+    }
+    if (engine->backend->fini != NULL) {
+        engine->backend->fini(engine);
+    }
+    if (engine->bitpacked) {
+        bitgrid_free(&engine->packed);
+    }
+    affinity_free(&engine->affinity);
+    profile_free(engine->profile);
+    free(engine);
+
+}
@@ -0,0 +1,211 @@
+/*
+ * ca_grid.c
+ *
+ * Cellspace storage: allocation, random initial state and printing.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ca_internal.h"
+
+
+/*
+ * Allocate bytes aligned to CA_ALIGN, exit on failure.
+ */
+void *ca_alloc(size_t bytes) {
+
+    void *p = NULL;
+    if (posix_memalign(&p, CA_ALIGN, bytes > 0 ? bytes : CA_ALIGN) != 0) {
+        printf("ERROR: could not allocate %zu bytes\n", bytes);
+        exit(EXIT_FAILURE);
+    }
+    return p;
+
+}
+
+
+/*
+ * Grid with dimensions only and no cell storage, for ranks or drivers that
+ * never hold the whole cellspace.
+ */
+ca_grid_t *ca_grid_shape(int rows, int cols) {
+
+    ca_grid_t *grid = (ca_grid_t*) calloc(1, sizeof(ca_grid_t));
+    grid->rows = rows;
+    grid->cols = cols;
+    grid->max_rows = rows + 2;
+    grid->max_cols = cols + 2;
+    return grid;
+
+}
+
+
+/*
+ * Grid of rows x cols interior cells plus the ghost border, all cells 0.
+ */
+ca_grid_t *ca_grid_create(int rows, int cols) {
+
+    ca_grid_t *grid = ca_grid_shape(rows, cols);
+    size_t bytes = (size_t)grid->max_rows * grid->max_cols * sizeof(int);
+    grid->cells = (int*) ca_alloc(bytes);
+    grid->next = (int*) ca_alloc(bytes);
+    memset(grid->cells, 0, bytes);
+    memset(grid->next, 0, bytes);
+    return grid;
+
+}
+
+
+/*
+ * Grid with cell storage that is allocated but not yet written, to be
+ * filled by ca_grid_randomize() or by ca_engine_create() with
+ * config.randomize. Large buffers come straight from mmap, so each page
+ * is placed on the NUMA node of the thread that writes it first.
+ */
+ca_grid_t *ca_grid_alloc(int rows, int cols) {
+
+    ca_grid_t *grid = ca_grid_shape(rows, cols);
+    size_t bytes = (size_t)grid->max_rows * grid->max_cols * sizeof(int);
+    grid->cells = (int*) ca_alloc(bytes);
+    grid->next = (int*) ca_alloc(bytes);
+    return grid;
+
+}
+
+
+void ca_grid_free(ca_grid_t *grid) {
+
+    if (grid == NULL) {
+        return;
+    }
+    free(grid->cells);
+    free(grid->next);
+    free(grid);
+
+}
+
+
+/*
+ * Set the ghost border to 1's in both generations. Border cells are never
+ * written by a step, so they have to be present in each buffer.
+ */
+void ca_grid_set_border(ca_grid_t *grid) {
+
+    int mr = grid->max_rows, mc = grid->max_cols;
+    int *buffers[2] = {grid->cells, grid->next};
+    for (int b = 0; b < 2; b++) {
+        int *p = buffers[b];
+        for (int y = 0; y < mc; y++) {
+            p[y] = 1;
+            p[(mr-1)*mc + y] = 1;
+        }
+        for (int x = 0; x < mr; x++) {
+            p[x*mc] = 1;
+            p[x*mc + mc-1] = 1;
+        }
+    }
+
+}
+
+
+/*
+ * Randomly generate the cellspace. Each cell has two possible states:
+ * 0 (inactive) or 1 (active), and the outer layer is all 1's to account
+ * for border cell transitions.
+ *
+ * Cell i (row-major over the interior) takes bit i % 64 of
+ * prng_hash(seed, PRNG_STREAM_GRID, i / 64), so the cellspace depends only
+ * on the seed and any part of it can be generated on its own.
+ */
+void ca_grid_randomize(ca_grid_t *grid, uint64_t seed) {
+
+    ca_grid_randomize_rows(grid, seed, 1, grid->rows + 1);
+
+}
+
+
+/*
+ * Cells [col, col+ncols) of interior row x (both 1-based) of a cellspace
+ * with cols interior columns, written to dst[0 .. ncols).
+ */
+void ca_random_cells(uint64_t seed, int cols, int x, int col, int ncols, int *dst) {
+
+    uint64_t i = (uint64_t)(x-1) * cols + (col-1);
+    uint64_t bits = prng_hash(seed, PRNG_STREAM_GRID, i / 64) >> (i % 64);
+    for (int y = 0; y < ncols; y++, i++) {
+        if (i % 64 == 0) {
+            bits = prng_hash(seed, PRNG_STREAM_GRID, i / 64);
+        }
+        dst[y] = bits & 1;
+        bits >>= 1;
+    }
+
+}
+
+
+/*
+ * ca_grid_randomize() for interior rows [start, end) only, plus the ghost
+ * rows next to them. Writes every word of those rows in both generations
+ * (next gets the border and 0's), so a thread that fills its own band is
+ * the first to touch its pages.
+ */
+void ca_grid_randomize_rows(ca_grid_t *grid, uint64_t seed, int start, int end) {
+
+    const int mc = grid->max_cols;
+    int first = start <= 1 ? 0 : start;
+    int last = end >= grid->max_rows - 1 ? grid->max_rows : end;
+
+    for (int x = first; x < last; x++) {
+        int *row = grid->cells + (size_t)x*mc;
+        int *next = grid->next + (size_t)x*mc;
+        if (x == 0 || x == grid->max_rows - 1) {
+            for (int y = 0; y < mc; y++) {
+                row[y] = 1;
+                next[y] = 1;
+            }
+            continue;
+        }
+        ca_random_cells(seed, grid->cols, x, 1, grid->cols, row + 1);
+        memset(next, 0, mc * sizeof(int));
+        row[0] = row[mc-1] = 1;
+        next[0] = next[mc-1] = 1;
+    }
+
+}
+
+
+/*
+ * Print the cellspace.
+ *
+ * Notice the for loop is from [1, max_rows-1]:
+ * this is because of the ghost border.
+ */
+void ca_grid_print(const ca_grid_t *grid, int timestep) {
+
+    printf("TIMESTEP # %d\n", timestep);
+    for (int x = 1; x < grid->max_rows-1; x++) {
+        for (int y = 1; y < grid->max_cols-1; y++) {
+            printf(" %d ", *(grid->cells + x*grid->max_cols + y));
+        }
+        printf("\n");
+    }
+    printf("\n");
+
+}
+
+
+/*
+ * Make the freshly computed generation current.
+ */
+void ca_grid_swap(ca_grid_t *grid) {
+
+    int *tmp = grid->cells;
+    grid->cells = grid->next;
+    grid->next = tmp;
+
+}
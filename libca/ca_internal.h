@@ -0,0 +1,112 @@
+/*
+ * ca_internal.h
+ *
+ * Engine and backend definitions shared by the libca sources. Not part of
+ * the public API in ca.h.
+ *
+ * A backend provides init/step and optionally sync, describe and fini. A
+ * backend with threads of its own places them in init with
+ * ca_engine_affinity() and affinity_pin() (pool_pin() for a pool), and
+ * gives them slots in engine->profile with profile_threads() (pool_create()
+ * for a pool). The engine resolves the kernel before init, so a backend
+ * only has to look at engine->row_kernel and engine->bitpacked:
+ *
+ *   int        row_kernel == NULL, bitpacked == false: engine->transition per
+ *              cell (ca_transition(), or lut_transition() for the lut kernel)
+ *   row        row_kernel != NULL: one call per row (simd_kernel.c)
+ *   bitpacked  the generation lives in engine->packed (bitgrid.c) and is only
+ *              unpacked into grid->cells by ca_engine_sync()
+ *
+ * Rules other than B3/S23 (engine->custom_rule) only run as int: the engine
+ * installs the rule's specialized row kernel if it has one, and
+ * rule_transition()/rule_row() on its table otherwise. ca_sweep_row()
+ * hides the difference from backends that work on rows.
+ */
+
+#ifndef CA_INTERNAL_H
+#define CA_INTERNAL_H
+
+#include "ca.h"
+#include "bitgrid.h"
+#include "simd_kernel.h"
+#include "lut_kernel.h"
+#include "rule.h"
+#include "prng.h"
+#include "affinity.h"
+#include "checkpoint.h"
+#include "pattern.h"
+#include "profile.h"
+
+/* kernels a backend can run, see ca_backend.kernels */
+#define CA_KERNEL_INT       0x1
+#define CA_KERNEL_ROW       0x2
+#define CA_KERNEL_BITPACKED 0x4
+#define CA_KERNEL_ALL       (CA_KERNEL_INT | CA_KERNEL_ROW | CA_KERNEL_BITPACKED)
+
+/* next state of cell (x,y) of a matrix with row stride stride */
+typedef int (*cell_kernel_t)(const ca_rule_t *rule, const int *p, int stride,
+                             int x, int y);
+
+struct ca_backend {
+    const char *name;
+    unsigned kernels;
+    bool tiles;                                 /* supports config.tile_size */
+    bool random;                                /* draws from engine->prng/counter while
+                                                   stepping: restarts need the same backend */
+    int (*init)(ca_engine_t *engine);           /* 0 on success */
+    void (*step)(ca_engine_t *engine, int generations);
+    void (*sync)(ca_engine_t *engine);          /* may be NULL */
+    void (*describe)(ca_engine_t *engine, char *buf, size_t len); /* may be NULL */
+    void (*randomize)(ca_engine_t *engine);     /* initial fill on the backend's threads
+                                                   with ca_fill_rows(); may be NULL */
+    void (*fini)(ca_engine_t *engine);          /* may be NULL */
+    void (*profile)(ca_engine_t *engine);       /* ca_engine_profile() over all processes;
+                                                   may be NULL */
+};
+
+struct ca_engine {
+    const ca_backend_t *backend;
+    ca_grid_t *grid;
+    ca_config_t config;
+    const char *kernel_name;
+    row_kernel_t row_kernel;
+    cell_kernel_t transition;
+    ca_rule_t rule;
+    bool custom_rule;   /* rule is not B3/S23 */
+    bool bitpacked;
+    bitgrid_t packed;
+    prng_t prng;        /* stream 0 of config.seed, for the calling thread */
+    affinity_t affinity; /* config.affinity resolved for the backend's threads */
+    int timestep;       /* generations done so far */
+    uint64_t counter;   /* updates done so far (rand_ind_pthreads) */
+    const checkpoint_t *restart; /* config.restart, mapped in ca_engine_create() */
+    const pattern_t *pattern; /* config.pattern, mapped in ca_engine_create() */
+    profile_t *profile; /* phase times per thread, NULL unless built with CA_PROFILE */
+    void *state;        /* backend private data */
+};
+
+bool ca_transition(const int *p, int stride, int x, int y);
+int ca_cell(const ca_rule_t *rule, const int *p, int stride, int x, int y);
+bool ca_has_rows(const ca_engine_t *engine);
+void ca_sweep_row(const ca_engine_t *engine, const int *up, const int *mid,
+                  const int *down, int *out, int cols);
+void ca_sweep_rows(const ca_engine_t *engine, const int *src, int *dst,
+                   int start, int end);
+void ca_grid_swap(ca_grid_t *grid);
+void ca_fill_rows(ca_engine_t *engine, int start, int end);
+void ca_engine_affinity(ca_engine_t *engine, int threads, int first);
+void ca_bind_rows(ca_engine_t *engine, int rank, int start, int end);
+void ca_random_cells(uint64_t seed, int cols, int x, int col, int ncols, int *dst);
+void *ca_alloc(size_t bytes);
+
+/* built-in backends */
+extern const ca_backend_t ca_backend_serial;
+extern const ca_backend_t ca_backend_pthreads;
+extern const ca_backend_t ca_backend_omp;
+extern const ca_backend_t ca_backend_hashlife;
+extern const ca_backend_t ca_backend_rand_ind;
+extern const ca_backend_t ca_backend_rand_ind_pthreads;
+extern const ca_backend_t ca_backend_rand_order;
+extern const ca_backend_t ca_backend_rand_order_pthreads;
+
+#endif
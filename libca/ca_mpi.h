@@ -0,0 +1,22 @@
+/*
+ * ca_mpi.h
+ *
+ * MPI backend for libca, shipped in libca_mpi.a (libca_mpi_omp.a with
+ * OpenMP). Call ca_mpi_register() after MPI_Init() to make the "mpi"
+ * backend available to ca_engine_create().
+ *
+ * ca_mpi_snapshot() writes an mpi engine's cellspace to one shared
+ * checkpoint file, each rank its own part with collective MPI-IO. It is
+ * collective over MPI_COMM_WORLD. Any synchronous backend, mpi included,
+ * can restart from the file with config.restart.
+ */
+
+#ifndef CA_MPI_H
+#define CA_MPI_H
+
+#include "ca.h"
+
+int ca_mpi_register();
+int ca_mpi_snapshot(ca_engine_t *engine, const char *path, bool packed);
+
+#endif
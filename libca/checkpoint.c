@@ -0,0 +1,354 @@
+/*
+ * checkpoint.c
+ *
+ * Writing and restarting from checkpoint files, see checkpoint.h.
+ *
+ * A checkpoint is written through a shared mapping into path.tmp, flushed
+ * to disk and renamed over path, so a job killed while writing still leaves
+ * the previous checkpoint intact. A bit-packed engine is written straight
+ * from its packed buffer, any other after ca_engine_sync().
+ *
+ * A restart maps the file read-only. ca_engine_create() hands each thread
+ * the band of rows it would otherwise fill from the seed, and the thread
+ * unpacks those rows straight out of the page cache: nothing is copied
+ * through a read buffer, and the grid pages are first touched by the
+ * thread that steps them.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ca_internal.h"
+#include "checkpoint.h"
+
+
+/*
+ * Bytes of one payload row.
+ */
+size_t checkpoint_row_bytes(uint32_t bits, int max_cols) {
+
+    if (bits == 1) {
+        return (size_t)(max_cols + 63) / 64 * sizeof(uint64_t);
+    }
+    return (size_t)max_cols;
+
+}
+
+
+/*
+ * Payload form of the ncols cells in row: one byte each with bits 8, or
+ * packed into whole uint64_t words with bits 1 (row then starts a row).
+ */
+void checkpoint_pack_row(const int *row, int ncols, uint32_t bits, unsigned char *dst) {
+
+    if (bits == 8) {
+        for (int y = 0; y < ncols; y++) {
+            dst[y] = (unsigned char)row[y];
+        }
+        return;
+    }
+    uint64_t *words = (uint64_t*) dst;
+    for (int w = 0; w < (ncols + 63) / 64; w++) {
+        uint64_t word = 0;
+        for (int y = w*64; y < ncols && y < (w+1)*64; y++) {
+            word |= (uint64_t)(row[y] == 1) << (y % 64);
+        }
+        words[w] = word;
+    }
+
+}
+
+
+/*
+ * Inverse of checkpoint_pack_row().
+ */
+void checkpoint_unpack_row(const unsigned char *src, int ncols, uint32_t bits, int *row) {
+
+    if (bits == 8) {
+        for (int y = 0; y < ncols; y++) {
+            row[y] = src[y];
+        }
+        return;
+    }
+    const uint64_t *words = (const uint64_t*) src;
+    for (int y = 0; y < ncols; y++) {
+        row[y] = (words[y / 64] >> (y % 64)) & 1;
+    }
+
+}
+
+
+/*
+ * Header for a checkpoint of the engine's current state with the payload
+ * stored at bits per cell.
+ */
+void checkpoint_fill_header(const ca_engine_t *engine, uint32_t bits,
+                            checkpoint_header_t *header) {
+
+    const ca_grid_t *grid = engine->grid;
+
+    memset(header, 0, sizeof(checkpoint_header_t));
+    memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header->header_bytes = sizeof(checkpoint_header_t);
+    header->bits = bits;
+    header->random = engine->backend->random;
+    header->rows = grid->rows;
+    header->cols = grid->cols;
+    header->timestep = engine->timestep;
+    header->seed = engine->config.seed;
+    memcpy(header->prng, engine->prng.s, sizeof(header->prng));
+    header->counter = engine->counter;
+    long page = sysconf(_SC_PAGESIZE);
+    header->payload = (sizeof(checkpoint_header_t) + page - 1) / page * page;
+    header->payload_bytes = checkpoint_row_bytes(bits, grid->max_cols) * grid->max_rows;
+    snprintf(header->rule, sizeof(header->rule), "%s", engine->rule.name);
+    snprintf(header->backend, sizeof(header->backend), "%s", engine->backend->name);
+
+}
+
+
+/*
+ * Read and check the header of the checkpoint at path. Returns -1 (after
+ * printing why) if it can't be read or isn't a checkpoint.
+ */
+int checkpoint_header(const char *path, checkpoint_header_t *header) {
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        printf("ERROR: could not open checkpoint '%s'\n", path);
+        return -1;
+    }
+    size_t n = fread(header, 1, sizeof(checkpoint_header_t), f);
+    fclose(f);
+    if (n != sizeof(checkpoint_header_t)
+            || memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0
+            || header->header_bytes != sizeof(checkpoint_header_t)
+            || (header->bits != 1 && header->bits != 8)
+            || header->rows < 0 || header->cols < 0) {
+        printf("ERROR: '%s' is not a checkpoint of this version\n", path);
+        return -1;
+    }
+    header->rule[RULE_NAME_LEN-1] = '\0';
+    header->backend[sizeof(header->backend)-1] = '\0';
+    return 0;
+
+}
+
+
+/*
+ * Map the checkpoint at path for restarting engine. Returns -1 (after
+ * printing why) unless it holds a cellspace of the engine's grid size and
+ * rule, written by the same backend if either one is asynchronous.
+ */
+int checkpoint_open(checkpoint_t *c, const char *path, const ca_engine_t *engine) {
+
+    checkpoint_header_t header;
+    const ca_grid_t *grid = engine->grid;
+
+    memset(c, 0, sizeof(checkpoint_t));
+    if (checkpoint_header(path, &header) != 0) {
+        return -1;
+    }
+    if (header.rows != grid->rows || header.cols != grid->cols) {
+        printf("ERROR: checkpoint '%s' is %d x %d, not %d x %d\n", path,
+               header.rows, header.cols, grid->rows, grid->cols);
+        return -1;
+    }
+    if (strcmp(header.rule, engine->rule.name) != 0) {
+        printf("ERROR: checkpoint '%s' was written with rule %s, not %s\n", path,
+               header.rule, engine->rule.name);
+        return -1;
+    }
+    // the asynchronous backends continue their own random streams; any
+    // synchronous backend can take over from another
+    if ((engine->backend->random || header.random) &&
+            strcmp(header.backend, engine->backend->name) != 0) {
+        printf("ERROR: checkpoint '%s' was written by backend %s, not %s\n", path,
+               header.backend, engine->backend->name);
+        return -1;
+    }
+
+    c->fd = open(path, O_RDONLY);
+    struct stat st;
+    if (c->fd < 0 || fstat(c->fd, &st) != 0) {
+        printf("ERROR: could not open checkpoint '%s'\n", path);
+        if (c->fd >= 0) {
+            close(c->fd);
+        }
+        return -1;
+    }
+    size_t bytes = checkpoint_row_bytes(header.bits, grid->max_cols) * grid->max_rows;
+    if (header.payload_bytes != bytes || header.payload < sizeof(checkpoint_header_t)
+            || (uint64_t)st.st_size < header.payload + bytes) {
+        printf("ERROR: checkpoint '%s' is truncated\n", path);
+        close(c->fd);
+        return -1;
+    }
+    c->size = st.st_size;
+    c->map = mmap(NULL, c->size, PROT_READ, MAP_SHARED, c->fd, 0);
+    if (c->map == MAP_FAILED) {
+        printf("ERROR: could not map checkpoint '%s'\n", path);
+        close(c->fd);
+        return -1;
+    }
+    c->header = (const checkpoint_header_t*) c->map;
+    c->cells = (const unsigned char*) c->map + header.payload;
+    return 0;
+
+}
+
+
+/*
+ * Interior rows [start, end) of grid from the checkpoint, plus the ghost
+ * rows next to them, like ca_grid_randomize_rows(): both generations are
+ * written, next with the border and 0's.
+ */
+void checkpoint_rows(const checkpoint_t *c, ca_grid_t *grid, int start, int end) {
+
+    const int mc = grid->max_cols;
+    const uint32_t bits = c->header->bits;
+    const size_t stride = checkpoint_row_bytes(bits, mc);
+    int first = start <= 1 ? 0 : start;
+    int last = end >= grid->max_rows - 1 ? grid->max_rows : end;
+
+    if (last <= first) {
+        return;
+    }
+    // read this band ahead, the other threads take care of theirs
+    long page = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (uintptr_t)(c->cells + (size_t)first*stride) & ~(uintptr_t)(page - 1);
+    madvise((void*)begin, (uintptr_t)(c->cells + (size_t)last*stride) - begin, MADV_WILLNEED);
+
+    for (int x = first; x < last; x++) {
+        int *row = grid->cells + (size_t)x*mc;
+        int *next = grid->next + (size_t)x*mc;
+        checkpoint_unpack_row(c->cells + (size_t)x*stride, mc, bits, row);
+        if (x == 0 || x == grid->max_rows - 1) {
+            memcpy(next, row, mc * sizeof(int));
+        } else {
+            memset(next, 0, mc * sizeof(int));
+            next[0] = next[mc-1] = 1;
+        }
+    }
+
+}
+
+
+/*
+ * The n cells of payload row x (ghost border counted) from column col on.
+ */
+void checkpoint_cells(const checkpoint_t *c, int x, int col, int n, int *dst) {
+
+    const uint32_t bits = c->header->bits;
+    const unsigned char *src = c->cells + (size_t)x * checkpoint_row_bytes(bits, c->header->cols + 2);
+
+    if (bits == 8) {
+        for (int y = 0; y < n; y++) {
+            dst[y] = src[col + y];
+        }
+        return;
+    }
+    const uint64_t *words = (const uint64_t*) src;
+    for (int y = col; y < col + n; y++) {
+        dst[y - col] = (words[y / 64] >> (y % 64)) & 1;
+    }
+
+}
+
+
+void checkpoint_close(checkpoint_t *c) {
+
+    munmap(c->map, c->size);
+    close(c->fd);
+
+}
+
+
+static int write_checkpoint(ca_engine_t *engine, const char *path) {
+
+    const ca_grid_t *grid = engine->grid;
+    const int mr = grid->max_rows, mc = grid->max_cols;
+
+    if (engine->bitpacked) {
+        if (engine->backend->sync != NULL) {
+            engine->backend->sync(engine);
+        }
+    } else {
+        ca_engine_sync(engine);
+    }
+
+    checkpoint_header_t header;
+    checkpoint_fill_header(engine, engine->rule.states > 2 ? 8 : 1, &header);
+    size_t stride = checkpoint_row_bytes(header.bits, mc);
+
+    size_t size = header.payload + header.payload_bytes;
+    size_t len = strlen(path) + 5;
+    char *tmp = (char*) malloc(len);
+    snprintf(tmp, len, "%s.tmp", path);
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, size) != 0) {
+        printf("ERROR: could not create checkpoint '%s'\n", tmp);
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmp);
+        }
+        free(tmp);
+        return -1;
+    }
+    unsigned char *map = (unsigned char*) mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                               MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        printf("ERROR: could not map checkpoint '%s'\n", tmp);
+        close(fd);
+        unlink(tmp);
+        free(tmp);
+        return -1;
+    }
+
+    memcpy(map, &header, sizeof(header));
+    unsigned char *cells = map + header.payload;
+    if (engine->bitpacked) {
+        // the packed rows are the payload rows already
+        memcpy(cells, engine->packed.cells, header.payload_bytes);
+    } else {
+        for (int x = 0; x < mr; x++) {
+            checkpoint_pack_row(grid->cells + (size_t)x*mc, mc, header.bits,
+                                cells + (size_t)x*stride);
+        }
+    }
+
+    int err = munmap(map, size) != 0 || fsync(fd) != 0;
+    err |= close(fd) != 0;
+    if (err || rename(tmp, path) != 0) {
+        printf("ERROR: could not write checkpoint '%s'\n", path);
+        unlink(tmp);
+        free(tmp);
+        return -1;
+    }
+    free(tmp);
+    return 0;
+
+}
+
+
+/*
+ * Write the engine's current generation to path. Returns 0 on success, -1
+ * (after printing why) if the file can't be written; path is then left as
+ * it was.
+ */
+int ca_engine_checkpoint(ca_engine_t *engine, const char *path) {
+
+    PROFILE_BEGIN(engine->profile, 0, PROFILE_OUTPUT);
+    int err = write_checkpoint(engine, path);
+    PROFILE_END(engine->profile, 0);
+    return err;
+
+}
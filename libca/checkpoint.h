@@ -0,0 +1,68 @@
+/*
+ * checkpoint.h
+ *
+ * Binary checkpoint files (ca_engine_checkpoint(), config.restart). A file
+ * is a checkpoint_header_t followed, at a page aligned offset, by the whole
+ * cellspace including the ghost border:
+ *
+ *   bits 1   two state rules, in the bitgrid.h layout: ceil(max_cols/64)
+ *            uint64_t words per row, column c in bit c % 64 of word c / 64
+ *   bits 8   Generations rules, one byte per cell, max_cols bytes per row
+ *
+ * The header holds everything else a run depends on: the timestep, the
+ * seed, the state of engine->prng and engine->counter, and the backend that
+ * wrote it: an asynchronous backend only resumes its own checkpoints, a
+ * synchronous one any synchronous backend's. Numbers are in the byte order
+ * of the host that wrote the file.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ca.h"
+#include "rule.h"
+
+#define CHECKPOINT_MAGIC "CACKPT1"
+
+typedef struct {
+    char magic[8];              /* CHECKPOINT_MAGIC */
+    uint32_t header_bytes;      /* sizeof(checkpoint_header_t) */
+    uint32_t bits;              /* bits per cell in the payload, 1 or 8 */
+    uint32_t random;            /* written by a backend with ca_backend.random */
+    uint32_t reserved;
+    int32_t rows;               /* interior rows */
+    int32_t cols;               /* interior cols */
+    uint64_t timestep;
+    uint64_t seed;
+    uint64_t prng[4];           /* engine->prng */
+    uint64_t counter;           /* engine->counter */
+    uint64_t payload;           /* file offset of the cells */
+    uint64_t payload_bytes;
+    char rule[RULE_NAME_LEN];   /* canonical rule string */
+    char backend[32];           /* backend that wrote it */
+} checkpoint_header_t;
+
+/* a checkpoint mapped for reading */
+typedef struct {
+    int fd;
+    void *map;
+    size_t size;
+    const checkpoint_header_t *header;
+    const unsigned char *cells;
+} checkpoint_t;
+
+size_t checkpoint_row_bytes(uint32_t bits, int max_cols);
+void checkpoint_pack_row(const int *row, int ncols, uint32_t bits, unsigned char *dst);
+void checkpoint_unpack_row(const unsigned char *src, int ncols, uint32_t bits, int *row);
+void checkpoint_fill_header(const ca_engine_t *engine, uint32_t bits,
+                            checkpoint_header_t *header);
+int checkpoint_header(const char *path, checkpoint_header_t *header);
+int checkpoint_open(checkpoint_t *c, const char *path, const ca_engine_t *engine);
+void checkpoint_rows(const checkpoint_t *c, ca_grid_t *grid, int start, int end);
+void checkpoint_cells(const checkpoint_t *c, int x, int col, int n, int *dst);
+void checkpoint_close(checkpoint_t *c);
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * ensemble.c
+ *
+ * Bit-sliced ensemble: up to 64 independent simulations of the same grid
+ * size and rule stepped together. Cell (x,y) of every member lives in one
+ * uint64_t, member k in bit k, so the neighbor count of a cell is summed
+ * for all members at once by bitwise adders over its eight neighbor words
+ * (the bitgrid.c adders, slicing across members instead of across
+ * columns). The ghost border word has every bit set, so each member sees
+ * the usual border of live cells.
+ *
+ * Rows are split across config.threads OpenMP threads.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ca_internal.h"
+
+struct ca_ensemble {
+    int rows;               /* interior rows */
+    int cols;               /* interior cols */
+    int max_cols;           /* cols + ghost border, also the row stride */
+    int members;
+    int threads;
+    ca_rule_t rule;
+    bool life;              /* B3/S23: skip the generic count match */
+    int counts[9];          /* neighbor counts that appear in the rule */
+    int ncounts;
+    uint64_t birth[9];      /* all ones if born with counts[i] neighbors */
+    uint64_t survive[9];    /* all ones if surviving with counts[i] neighbors */
+    uint64_t *cells;        /* current generation */
+    uint64_t *next;         /* next generation */
+};
+
+
+/*
+ * Ensemble of members simulations of a rows x cols grid under config.rule,
+ * all cells dead. NULL if the rule is not Life-like.
+ */
+ca_ensemble_t *ca_ensemble_create(int rows, int cols, int members,
+                                  const ca_config_t *config) {
+
+    if (members < 1 || members > CA_ENSEMBLE_MAX) {
+        printf("ERROR: an ensemble has 1 to %d members\n", CA_ENSEMBLE_MAX);
+        return NULL;
+    }
+
+    ca_ensemble_t *e = (ca_ensemble_t*) calloc(1, sizeof(ca_ensemble_t));
+    const char *rule = config->rule != NULL ? config->rule : "B3/S23";
+    if (rule_parse(&e->rule, rule) != 0) {
+        printf("ERROR: invalid rule '%s', expected e.g. B3/S23 or B2/S/3\n", rule);
+        free(e);
+        return NULL;
+    }
+    if (e->rule.states > 2) {
+        printf("ERROR: ensembles only run Life-like rules\n");
+        free(e);
+        return NULL;
+    }
+    e->life = rule_is_life(&e->rule);
+    for (int n = 0; n < 9; n++) {
+        if (((e->rule.birth | e->rule.survive) >> n) & 1) {
+            e->counts[e->ncounts] = n;
+            e->birth[e->ncounts] = (e->rule.birth >> n) & 1 ? ~(uint64_t)0 : 0;
+            e->survive[e->ncounts] = (e->rule.survive >> n) & 1 ? ~(uint64_t)0 : 0;
+            e->ncounts++;
+        }
+    }
+
+    e->rows = rows;
+    e->cols = cols;
+    e->max_cols = cols + 2;
+    e->members = members;
+    e->threads = config->threads > 0 ? config->threads : 1;
+
+    size_t words = (size_t)(rows + 2) * e->max_cols;
+    e->cells = (uint64_t*) ca_alloc(words * sizeof(uint64_t));
+    e->next = (uint64_t*) ca_alloc(words * sizeof(uint64_t));
+    memset(e->cells, 0, words * sizeof(uint64_t));
+
+    // ghost border, in both buffers since a step never writes it
+    for (int y = 0; y < e->max_cols; y++) {
+        e->cells[y] = ~(uint64_t)0;
+        e->cells[(size_t)(rows + 1)*e->max_cols + y] = ~(uint64_t)0;
+    }
+    for (int x = 0; x < rows + 2; x++) {
+        e->cells[(size_t)x*e->max_cols] = ~(uint64_t)0;
+        e->cells[(size_t)x*e->max_cols + e->max_cols - 1] = ~(uint64_t)0;
+    }
+    memcpy(e->next, e->cells, words * sizeof(uint64_t));
+    return e;
+
+}
+
+
+void ca_ensemble_free(ca_ensemble_t *e) {
+
+    free(e->cells);
+    free(e->next);
+    free(e);
+
+}
+
+
+/*
+ * Fill member k at random from seed. Density 0.5 gives exactly the cells of
+ * ca_grid_randomize(grid, seed), so the member can be checked against a
+ * single run with the same seed; other densities draw one number per cell.
+ */
+void ca_ensemble_randomize(ca_ensemble_t *e, int member, uint64_t seed, double density) {
+
+    uint64_t bit = (uint64_t)1 << member;
+    // alive below threshold, out of 2^53
+    uint64_t threshold = density <= 0.0 ? 0 :
+                         density >= 1.0 ? (uint64_t)1 << 53 :
+                         (uint64_t)(density * (double)((uint64_t)1 << 53));
+
+    for (int x = 1; x <= e->rows; x++) {
+        uint64_t i = (uint64_t)(x-1) * e->cols;
+        uint64_t *row = e->cells + (size_t)x*e->max_cols;
+        for (int y = 1; y <= e->cols; y++, i++) {
+            bool alive;
+            if (density == 0.5) {
+                alive = (prng_hash(seed, PRNG_STREAM_GRID, i / 64) >> (i % 64)) & 1;
+            } else {
+                alive = (prng_hash(seed, PRNG_STREAM_DENSITY, i) >> 11) < threshold;
+            }
+            row[y] = alive ? row[y] | bit : row[y] & ~bit;
+        }
+    }
+
+}
+
+
+/*
+ * Sum of three one-bit inputs per lane: *s gets the ones bit and *cy the
+ * twos bit.
+ */
+static inline void full_add(uint64_t a, uint64_t b, uint64_t c,
+                            uint64_t *s, uint64_t *cy) {
+
+    uint64_t t = a ^ b;
+    *s = t ^ c;
+    *cy = (a & b) | (t & c);
+
+}
+
+
+/*
+ * Next state of every member of cell y of row mid. The eight neighbors are
+ * summed into the bit planes count = b0 + 2*b1 + 4*b2 + 8*b3 (0..8, exact).
+ * With life set the rule is B3/S23 and the rule tables of e are not used.
+ */
+static inline uint64_t next_word(const ca_ensemble_t *e, const uint64_t *up,
+                                 const uint64_t *mid, const uint64_t *down,
+                                 int y, bool life) {
+
+    uint64_t s_up, c_up, s_down, c_down, b0, k, t0, t1;
+    full_add(up[y-1], up[y], up[y+1], &s_up, &c_up);
+    full_add(down[y-1], down[y], down[y+1], &s_down, &c_down);
+    uint64_t s_mid = mid[y-1] ^ mid[y+1];
+    uint64_t c_mid = mid[y-1] & mid[y+1];
+
+    full_add(s_up, s_mid, s_down, &b0, &k);
+    full_add(c_up, c_mid, c_down, &t0, &t1);
+    uint64_t b1 = t0 ^ k;
+    uint64_t t2 = t0 & k;
+    uint64_t b2 = t1 ^ t2;
+    uint64_t b3 = t1 & t2;
+
+    uint64_t alive = mid[y];
+    if (life) {
+        // count == 3, or count == 2 and alive now
+        return b1 & ~b2 & ~b3 & (b0 | alive);
+    }
+
+    // only the counts named in the rule can make a cell live
+    uint64_t next = 0;
+    for (int i = 0; i < e->ncounts; i++) {
+        int n = e->counts[i];
+        uint64_t eq = (n & 1 ? b0 : ~b0) & (n & 2 ? b1 : ~b1)
+                    & (n & 4 ? b2 : ~b2) & (n & 8 ? b3 : ~b3);
+        next |= eq & ((alive & e->survive[i]) | (~alive & e->birth[i]));
+    }
+    return next;
+
+}
+
+
+/*
+ * Compute rows [1, rows] of src into dst; life is a compile-time constant
+ * in each call below, so the rule test leaves the inner loop.
+ */
+static inline void step_rows(const ca_ensemble_t *e, const uint64_t *src,
+                             uint64_t *dst, bool life) {
+
+    const int mc = e->max_cols;
+    const int rows = e->rows;
+    const int cols = e->cols;
+
+    #pragma omp parallel for num_threads(e->threads) schedule(static)
+    for (int x = 1; x <= rows; x++) {
+        const uint64_t *up = src + (size_t)(x-1)*mc;
+        const uint64_t *mid = src + (size_t)x*mc;
+        const uint64_t *down = src + (size_t)(x+1)*mc;
+        uint64_t *restrict out = dst + (size_t)x*mc;
+        for (int y = 1; y <= cols; y++) {
+            out[y] = next_word(e, up, mid, down, y, life);
+        }
+    }
+
+}
+
+
+void ca_ensemble_step(ca_ensemble_t *e, int generations) {
+
+    for (int t = 0; t < generations; t++) {
+        if (e->life) {
+            step_rows(e, e->cells, e->next, true);
+        } else {
+            step_rows(e, e->cells, e->next, false);
+        }
+        uint64_t *tmp = e->cells;
+        e->cells = e->next;
+        e->next = tmp;
+    }
+
+}
+
+
+/*
+ * Live cells of each member.
+ */
+void ca_ensemble_population(const ca_ensemble_t *e, long long *population) {
+
+    memset(population, 0, e->members * sizeof(long long));
+    uint64_t mask = e->members == 64 ? ~(uint64_t)0 : ((uint64_t)1 << e->members) - 1;
+
+    for (int x = 1; x <= e->rows; x++) {
+        const uint64_t *row = e->cells + (size_t)x*e->max_cols;
+        for (int y = 1; y <= e->cols; y++) {
+            uint64_t w = row[y] & mask;
+            while (w != 0) {
+                population[__builtin_ctzll(w)]++;
+                w &= w - 1;
+            }
+        }
+    }
+
+}
+
+
+/*
+ * Copy member k into an int grid of the same size, e.g. to print it.
+ */
+void ca_ensemble_extract(const ca_ensemble_t *e, int member, ca_grid_t *grid) {
+
+    for (int x = 1; x <= e->rows; x++) {
+        const uint64_t *row = e->cells + (size_t)x*e->max_cols;
+        for (int y = 1; y <= e->cols; y++) {
+            *(grid->cells + x*grid->max_cols + y) = (row[y] >> member) & 1;
+        }
+    }
+    ca_grid_set_border(grid);
+
+}
@@ -0,0 +1,262 @@
+/*
+ * frames.c
+ *
+ * Frame output off the compute thread. ca_frames_write() copies the
+ * interior of the grid, one byte per cell, into a free buffer of a fixed
+ * pool and queues it; a writer thread encodes the queued frames and writes
+ * each one with a single write(). Stepping only waits for the copy, or for a
+ * free buffer when the writer falls behind: the pool is the whole queue, so
+ * a slow disk holds the simulation back instead of growing memory.
+ *
+ * Every frame is a binary netpbm image, appended to one file:
+ *
+ *   .pbm   P4, one bit per cell, live cells black (two state rules)
+ *   .pgm   P5, one byte per cell holding the state, maxval states - 1
+ *
+ * with a "# timestep n" comment in its header. netpbm tools and most image
+ * libraries read such a file as a sequence of images.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "ca_internal.h"
+
+/* longest frame header */
+#define FRAMES_HEADER_LEN 64
+
+struct ca_frames {
+    int fd;
+    int rows;
+    int cols;
+    bool bitmap;            /* P4 instead of P5 */
+    int maxval;             /* P5 */
+    int depth;              /* buffers in the pool */
+    unsigned char **cells;  /* pool, rows * cols bytes each */
+    int *timestep;          /* timestep of the frame in each buffer */
+    int head;               /* oldest queued buffer */
+    int count;              /* queued buffers, the rest are free */
+    bool closing;
+    bool failed;            /* a write failed, later frames are dropped */
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    pthread_cond_t freed;
+    pthread_t writer;
+    char *out;              /* the writer's encoded frame */
+    profile_t *profile;     /* the engine's, the copy counts as its output */
+};
+
+
+/*
+ * Encode the frame in cells into f->out. Returns its length in bytes.
+ */
+static size_t encode(ca_frames_t *f, const unsigned char *cells, int timestep) {
+
+    char *out = f->out;
+    size_t n;
+    if (f->bitmap) {
+        n = snprintf(out, FRAMES_HEADER_LEN, "P4\n# timestep %d\n%d %d\n",
+                     timestep, f->cols, f->rows);
+        // rows start on a byte, first cell in the high bit
+        const int row_bytes = (f->cols + 7) / 8;
+        for (int x = 0; x < f->rows; x++) {
+            const unsigned char *row = cells + (size_t)x * f->cols;
+            unsigned char *dst = (unsigned char*) out + n;
+            memset(dst, 0, row_bytes);
+            int y = 0;
+            for (; y + 8 <= f->cols; y += 8) {
+                const unsigned char *c = row + y;
+                dst[y / 8] = (c[0] == 1) << 7 | (c[1] == 1) << 6 | (c[2] == 1) << 5 |
+                             (c[3] == 1) << 4 | (c[4] == 1) << 3 | (c[5] == 1) << 2 |
+                             (c[6] == 1) << 1 | (c[7] == 1);
+            }
+            for (; y < f->cols; y++) {
+                dst[y / 8] |= (row[y] == 1) << (7 - y % 8);
+            }
+            n += row_bytes;
+        }
+    } else {
+        n = snprintf(out, FRAMES_HEADER_LEN, "P5\n# timestep %d\n%d %d\n%d\n",
+                     timestep, f->cols, f->rows, f->maxval);
+        memcpy(out + n, cells, (size_t)f->rows * f->cols);
+        n += (size_t)f->rows * f->cols;
+    }
+    return n;
+
+}
+
+
+/*
+ * Writer thread: encode and write queued frames in order until closed and
+ * drained.
+ */
+static void *writer(void *arg) {
+
+    ca_frames_t *f = (ca_frames_t*) arg;
+
+    pthread_mutex_lock(&f->lock);
+    while (1) {
+        while (f->count == 0 && !f->closing) {
+            pthread_cond_wait(&f->queued, &f->lock);
+        }
+        if (f->count == 0) {
+            break;
+        }
+        int slot = f->head;
+        bool failed = f->failed;
+        pthread_mutex_unlock(&f->lock);
+
+        // the buffer is ours until it is handed back below
+        if (!failed) {
+            size_t len = encode(f, f->cells[slot], f->timestep[slot]);
+            size_t done = 0;
+            while (done < len) {
+                ssize_t w = write(f->fd, f->out + done, len - done);
+                if (w < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (w <= 0) {
+                    failed = true;
+                    break;
+                }
+                done += w;
+            }
+        }
+
+        pthread_mutex_lock(&f->lock);
+        f->failed = failed;
+        f->head = (f->head + 1) % f->depth;
+        f->count--;
+        pthread_cond_signal(&f->freed);
+    }
+    pthread_mutex_unlock(&f->lock);
+    return NULL;
+
+}
+
+
+/*
+ * Open path for the frames of engine's grid, with depth frame buffers (at
+ * least 2). The format follows the extension, see above. Returns NULL (after
+ * printing why) if the file can't be created or the format doesn't fit the
+ * rule.
+ */
+ca_frames_t *ca_frames_open(const char *path, const ca_engine_t *engine, int depth) {
+
+    const char *ext = strrchr(path, '.');
+    bool bitmap = ext != NULL && strcmp(ext, ".pbm") == 0;
+    if (!bitmap && (ext == NULL || strcmp(ext, ".pgm") != 0)) {
+        printf("ERROR: frames are written as .pbm or .pgm, not '%s'\n", path);
+        return NULL;
+    }
+    if (bitmap && engine->rule.states > 2) {
+        printf("ERROR: rule %s has %d states, write its frames as .pgm\n",
+               engine->rule.name, engine->rule.states);
+        return NULL;
+    }
+
+    ca_frames_t *f = (ca_frames_t*) calloc(1, sizeof(ca_frames_t));
+    f->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (f->fd < 0) {
+        printf("ERROR: could not create '%s'\n", path);
+        free(f);
+        return NULL;
+    }
+    f->rows = engine->grid->rows;
+    f->cols = engine->grid->cols;
+    f->bitmap = bitmap;
+    f->profile = engine->profile;
+    f->maxval = engine->rule.states > 2 ? engine->rule.states - 1 : 1;
+    f->depth = depth > 2 ? depth : 2;
+    f->cells = (unsigned char**) malloc(f->depth * sizeof(unsigned char*));
+    f->timestep = (int*) malloc(f->depth * sizeof(int));
+    for (int i = 0; i < f->depth; i++) {
+        f->cells[i] = (unsigned char*) malloc((size_t)f->rows * f->cols);
+    }
+    f->out = (char*) malloc(FRAMES_HEADER_LEN + (size_t)f->rows * f->cols);
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->queued, NULL);
+    pthread_cond_init(&f->freed, NULL);
+    pthread_create(&f->writer, NULL, writer, f);
+    return f;
+
+}
+
+
+/*
+ * Queue the current generation of grid (after ca_engine_sync()) as the frame
+ * of timestep. Waits only if every buffer is still queued. Returns -1 (after
+ * printing why) once a write has failed.
+ */
+int ca_frames_write(ca_frames_t *f, const ca_grid_t *grid, int timestep) {
+
+    PROFILE_BEGIN(f->profile, 0, PROFILE_OUTPUT);
+    pthread_mutex_lock(&f->lock);
+    while (f->count == f->depth && !f->failed) {
+        pthread_cond_wait(&f->freed, &f->lock);
+    }
+    if (f->failed) {
+        pthread_mutex_unlock(&f->lock);
+        printf("ERROR: could not write frame %d\n", timestep);
+        PROFILE_END(f->profile, 0);
+        return -1;
+    }
+    // the writer never touches the buffers past the queue
+    int slot = (f->head + f->count) % f->depth;
+    pthread_mutex_unlock(&f->lock);
+
+    unsigned char *dst = f->cells[slot];
+    for (int x = 1; x <= f->rows; x++) {
+        const int *row = grid->cells + (size_t)x * grid->max_cols + 1;
+        for (int y = 0; y < f->cols; y++) {
+            *dst++ = (unsigned char)row[y];
+        }
+    }
+    f->timestep[slot] = timestep;
+
+    pthread_mutex_lock(&f->lock);
+    f->count++;
+    pthread_cond_signal(&f->queued);
+    pthread_mutex_unlock(&f->lock);
+    PROFILE_END(f->profile, 0);
+    return 0;
+
+}
+
+
+/*
+ * Write out the queued frames and close the file. Returns -1 (after printing
+ * why) if any frame couldn't be written.
+ */
+int ca_frames_close(ca_frames_t *f) {
+
+    pthread_mutex_lock(&f->lock);
+    f->closing = true;
+    pthread_cond_signal(&f->queued);
+    pthread_mutex_unlock(&f->lock);
+    pthread_join(f->writer, NULL);
+
+    int err = close(f->fd) != 0 || f->failed ? -1 : 0;
+    if (err != 0) {
+        printf("ERROR: could not write all frames\n");
+    }
+    for (int i = 0; i < f->depth; i++) {
+        free(f->cells[i]);
+    }
+    free(f->cells);
+    free(f->timestep);
+    free(f->out);
+    pthread_mutex_destroy(&f->lock);
+    pthread_cond_destroy(&f->queued);
+    pthread_cond_destroy(&f->freed);
+    free(f);
+    return err;
+
+}
@@ -0,0 +1,84 @@
+/*
+ * lut_kernel.c
+ *
+ * Table-driven transition, see lut_kernel.h.
+ *
+ * Index layout: three bits per column, left column in bits 8-6, center
+ * column in bits 5-3 and right column in bits 2-0; within a column the row
+ * above is the high bit and the row below the low bit. The cell itself is
+ * bit 4.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include "lut_kernel.h"
+
+#define LUT_SIZE 512
+#define LUT_CENTER 4
+
+static unsigned char lut[LUT_SIZE];
+static bool lut_ready = false;
+
+
+/*
+ * Fill the table with the Game of Life rule.
+ */
+static void lut_init() {
+
+    if (lut_ready) {
+        return;
+    }
+    for (int idx = 0; idx < LUT_SIZE; idx++) {
+        int livingNeighbors = __builtin_popcount(idx & ~(1 << LUT_CENTER));
+        if (idx & (1 << LUT_CENTER)) {
+            lut[idx] = (livingNeighbors == 2 || livingNeighbors == 3);
+        } else {
+            lut[idx] = (livingNeighbors == 3);
+        }
+    }
+    lut_ready = true;
+
+}
+
+
+static inline unsigned column(const int *up, const int *mid, const int *down, int j) {
+
+    return (unsigned)(up[j] << 2 | mid[j] << 1 | down[j]);
+
+}
+
+
+static void row_lut(const int *up, const int *mid, const int *down,
+                    int *out, int cols) {
+
+    unsigned idx = column(up, mid, down, 0) << 3 | column(up, mid, down, 1);
+    for (int j = 1; j < cols-1; j++) {
+        idx = ((idx << 3) | column(up, mid, down, j+1)) & (LUT_SIZE - 1);
+        out[j] = lut[idx];
+    }
+
+}
+
+
+row_kernel_t lut_row_kernel() {
+
+    lut_init();
+    return row_lut;
+
+}
+
+
+int lut_transition(const ca_rule_t *rule, const int *p, int stride, int x, int y) {
+
+    (void)rule;
+
+    const int *up = p + (x-1)*stride;
+    const int *mid = p + x*stride;
+    const int *down = p + (x+1)*stride;
+
+    unsigned idx = column(up, mid, down, y-1) << 6
+                 | column(up, mid, down, y) << 3
+                 | column(up, mid, down, y+1);
+    return lut[idx];
+
+}
@@ -0,0 +1,30 @@
+/*
+ * lut_kernel.h
+ *
+ * Table-driven transition. The 3x3 neighborhood of a cell is packed into a
+ * 9 bit index into a precomputed 512 entry table of next states, so a cell
+ * costs one load instead of a loop over its neighbors with data dependent
+ * branches.
+ */
+
+#ifndef LUT_KERNEL_H
+#define LUT_KERNEL_H
+
+#include <stdbool.h>
+
+#include "simd_kernel.h"
+#include "rule.h"
+
+/*
+ * Row kernel (same contract as the simd kernels). The index slides along
+ * the row: each step shifts out the left column and ORs in the right one.
+ */
+row_kernel_t lut_row_kernel();
+
+/*
+ * Per cell evaluator (a cell_kernel_t), for the backends that update single
+ * cells. The table holds B3/S23, so rule is not used.
+ */
+int lut_transition(const ca_rule_t *rule, const int *p, int stride, int x, int y);
+
+#endif
@@ -0,0 +1,443 @@
+/*
+ * pattern.c
+ *
+ * Loading RLE and plaintext patterns, see pattern.h.
+ *
+ * pattern_open() scans the mapped file once and records where each row of
+ * the pattern starts. pattern_place() then seeks to the first row of its
+ * window and decodes only the window's rows, writing their cells straight
+ * into the grid. A thread fills its band with pattern_rows(): the band is
+ * cleared (first touch, like the seeded fill) and the window is its rows,
+ * so the threads decode in parallel and a run's startup costs the index
+ * scan plus one decode of the file, however many threads share it. (Every
+ * MPI rank opens, and so scans, the file itself.)
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ca_internal.h"
+#include "pattern.h"
+
+
+/*
+ * End of the line starting at s.
+ */
+static const char *line_end(const char *s, const char *end) {
+
+    const char *nl = (const char*) memchr(s, '\n', end - s);
+    return nl != NULL ? nl : end;
+
+}
+
+
+/*
+ * Start of the line after the one starting at s.
+ */
+static const char *next_line(const char *s, const char *end) {
+
+    const char *e = line_end(s, end);
+    return e < end ? e + 1 : end;
+
+}
+
+
+/* whitespace between RLE tokens; isspace() costs a call per byte */
+static inline bool is_blank(char c) {
+
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+
+}
+
+
+/*
+ * Golly's older S/B notation, "23/3" or "345/2/4" for Generations, as the
+ * B/S that rule_parse() reads ("B3/S23", "B2/S345/4"). Other rules are
+ * left as they are.
+ */
+static void sb_to_bs(char *rule, size_t len) {
+
+    const char *slash = strchr(rule, '/');
+    if (slash == NULL || strspn(rule, "012345678") != (size_t)(slash - rule)) {
+        return;
+    }
+    const char *born = slash + 1;
+    size_t born_len = strspn(born, "012345678");
+    const char *states = born + born_len;
+    if (*states != '\0' && (*states != '/' || states[1] == '\0' ||
+                             strspn(states + 1, "0123456789") != strlen(states + 1))) {
+        return;
+    }
+    char bs[64];
+    snprintf(bs, sizeof(bs), "B%.*s/S%.*s%s", (int)born_len, born, (int)(slash - rule), rule,
+             states);
+    snprintf(rule, len, "%s", bs);
+
+}
+
+
+/*
+ * Parse the RLE header line [s, end): "x = w, y = h, rule = r". Missing
+ * fields are left as they are. Returns -1 unless it is one.
+ */
+static int parse_header(const char *s, const char *end, int *width, int *height,
+                        char *rule, size_t len) {
+
+    while (s < end && isspace((unsigned char)*s)) {
+        s++;
+    }
+    if (s == end || *s != 'x') {
+        return -1;
+    }
+    while (s < end) {
+        // key = value, up to the next comma
+        while (s < end && (isspace((unsigned char)*s) || *s == ',')) {
+            s++;
+        }
+        const char *key = s;
+        while (s < end && isalpha((unsigned char)*s)) {
+            s++;
+        }
+        size_t key_len = s - key;
+        while (s < end && isspace((unsigned char)*s)) {
+            s++;
+        }
+        if (s == end || *s != '=') {
+            return key_len == 0 ? 0 : -1;
+        }
+        s++;
+        while (s < end && isspace((unsigned char)*s)) {
+            s++;
+        }
+        const char *value = s;
+        while (s < end && *s != ',' && *s != '\r' && *s != '\n') {
+            s++;
+        }
+        const char *value_end = s;
+        while (value_end > value && isspace((unsigned char)value_end[-1])) {
+            value_end--;
+        }
+        if (key_len == 1 && key[0] == 'x') {
+            *width = atoi(value);
+        } else if (key_len == 1 && key[0] == 'y') {
+            *height = atoi(value);
+        } else if (key_len == 4 && strncmp(key, "rule", 4) == 0 && rule != NULL) {
+            // drop a bounded grid suffix such as ":T100,100"
+            const char *colon = (const char*) memchr(value, ':', value_end - value);
+            if (colon != NULL) {
+                value_end = colon;
+            }
+            size_t n = value_end - value < (long)len - 1 ? (size_t)(value_end - value) : len - 1;
+            memcpy(rule, value, n);
+            rule[n] = '\0';
+            sb_to_bs(rule, len);
+        }
+    }
+    return 0;
+
+}
+
+
+/*
+ * Rule named in the RLE header of the pattern at path, "" if it has none.
+ * Returns -1 (after printing why) if the file can't be read.
+ */
+int pattern_rule(const char *path, char *rule, size_t len) {
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        printf("ERROR: could not open pattern '%s'\n", path);
+        return -1;
+    }
+    rule[0] = '\0';
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t n;
+    while ((n = getline(&line, &cap, f)) > 0) {
+        if (line[0] != '#') {
+            int width, height;
+            parse_header(line, line + n, &width, &height, rule, len);
+            break;
+        }
+    }
+    free(line);
+    fclose(f);
+    return 0;
+
+}
+
+
+/*
+ * Record where each row of an RLE pattern starts: one scan for the $ runs
+ * that end rows, without decoding any cells.
+ */
+static void index_rle(pattern_t *p) {
+
+    const char *s = p->data, *end = p->end;
+    int x = 0;
+    long n = 0;
+
+    p->rows = (pattern_row_t*) malloc((p->height > 0 ? p->height : 1) * sizeof(pattern_row_t));
+    if (p->height > 0) {
+        p->rows[0].data = s;
+        p->rows[0].row = 0;
+    }
+    while (s < end && x < p->height) {
+        char c = *s++;
+        if (c >= '0' && c <= '9') {
+            n = n*10 + (c - '0');
+        } else if (c == '$') {
+            int next = x + (n > 0 ? (int)n : 1);
+            // rows skipped by a run of $ are empty: start them where the next one does
+            for (int k = x + 1; k <= next && k < p->height; k++) {
+                p->rows[k].data = s;
+                p->rows[k].row = next;
+            }
+            x = next;
+            n = 0;
+        } else if (c == '!') {
+            s--;
+            break;
+        } else if (!is_blank(c)) {
+            n = 0;
+        }
+    }
+    // rows after the end of the data are empty
+    for (int k = x + 1; k < p->height; k++) {
+        p->rows[k].data = s;
+        p->rows[k].row = p->height;
+    }
+
+}
+
+
+/*
+ * Map the pattern at path and place it in engine's grid. Returns -1 (after
+ * printing why) if it can't be read or doesn't fit.
+ */
+int pattern_open(pattern_t *p, const char *path, const ca_engine_t *engine) {
+
+    const ca_grid_t *grid = engine->grid;
+    struct stat st;
+
+    memset(p, 0, sizeof(pattern_t));
+    p->fd = open(path, O_RDONLY);
+    if (p->fd < 0 || fstat(p->fd, &st) != 0) {
+        printf("ERROR: could not open pattern '%s'\n", path);
+        if (p->fd >= 0) {
+            close(p->fd);
+        }
+        return -1;
+    }
+    p->size = st.st_size;
+    if (p->size > 0) {
+        p->map = mmap(NULL, p->size, PROT_READ, MAP_SHARED, p->fd, 0);
+        if (p->map == MAP_FAILED) {
+            printf("ERROR: could not map pattern '%s'\n", path);
+            close(p->fd);
+            return -1;
+        }
+        madvise(p->map, p->size, MADV_SEQUENTIAL);
+    }
+    const char *s = (const char*) p->map, *end = s + p->size;
+    p->end = end;
+
+    // RLE has "#" comments and a header line, plaintext neither
+    bool comments = false;
+    while (s < end && *s == '#') {
+        s = next_line(s, end);
+        comments = true;
+    }
+    p->width = p->height = -1;
+    const char *next = line_end(s, end);
+    if (parse_header(s, next, &p->width, &p->height, NULL, 0) == 0) {
+        p->rle = true;
+        p->data = next_line(s, end);
+    } else if (comments) {
+        printf("ERROR: pattern '%s' has no RLE header line (x = ..., y = ...)\n", path);
+        pattern_close(p);
+        return -1;
+    } else {
+        // plaintext: one row per line that isn't a comment
+        p->data = s;
+        p->width = p->height = 0;
+        int cap = 0;
+        while (s < end) {
+            const char *e = line_end(s, end);
+            if (*s != '!') {
+                int w = (int)(e - s) - (e > s && e[-1] == '\r');
+                p->width = w > p->width ? w : p->width;
+                if (p->height == cap) {
+                    cap = cap > 0 ? 2*cap : 64;
+                    p->rows = (pattern_row_t*) realloc(p->rows, cap * sizeof(pattern_row_t));
+                }
+                p->rows[p->height].data = s;
+                p->rows[p->height].row = p->height;
+                p->height++;
+            }
+            s = next_line(s, end);
+        }
+    }
+    if (p->width < 0 || p->height < 0) {
+        printf("ERROR: pattern '%s' has no size in its header\n", path);
+        pattern_close(p);
+        return -1;
+    }
+    if (p->rle) {
+        index_rle(p);
+    }
+
+    // interior coordinates, centered unless given
+    int row = engine->config.pattern_row >= 0 ? engine->config.pattern_row
+                                              : (grid->rows - p->height) / 2;
+    int col = engine->config.pattern_col >= 0 ? engine->config.pattern_col
+                                              : (grid->cols - p->width) / 2;
+    if (row < 0 || col < 0 || row + p->height > grid->rows || col + p->width > grid->cols) {
+        printf("ERROR: the %d x %d pattern '%s' doesn't fit in the %d x %d grid at row %d, col %d\n",
+               p->height, p->width, path, grid->rows, grid->cols, row, col);
+        pattern_close(p);
+        return -1;
+    }
+    p->row = row + 1;
+    p->col = col + 1;
+    p->states = engine->rule.states;
+    return 0;
+
+}
+
+
+/*
+ * Write the pattern's cells in grid rows [first_row, first_row + rows) and
+ * columns [first_col, first_col + cols) (ghost border counted) to dst, which
+ * holds that window with row stride stride. Cells of the window outside the
+ * pattern are left alone.
+ */
+void pattern_place(const pattern_t *p, int first_row, int rows, int first_col, int cols,
+                   int *dst, int stride) {
+
+    // the window in pattern coordinates
+    const int lo = first_row - p->row, hi = lo + rows;
+    const int clo = first_col - p->col, chi = clo + cols;
+    const char *end = p->end;
+
+    if (hi <= 0 || lo >= p->height || p->height == 0) {
+        return;
+    }
+    const int from = lo > 0 ? lo : 0;
+
+    if (!p->rle) {
+        const int to = hi < p->height ? hi : p->height;
+        for (int x = from; x < to; x++) {
+            const char *s = p->rows[x].data, *e = line_end(s, end);
+            int *row = dst + (size_t)(x - lo) * stride;
+            for (int y = clo > 0 ? clo : 0; y < chi && s + y < e; y++) {
+                if (s[y] == 'O' || s[y] == '*') {
+                    row[y - clo] = 1;
+                }
+            }
+        }
+        return;
+    }
+
+    // decode from the first row of the window on
+    const char *s = p->rows[from].data;
+    int x = p->rows[from].row;
+    int y = 0;
+    long n = 0;
+    while (s < end && x < hi) {
+        char c = *s++;
+        if (c >= '0' && c <= '9') {
+            n = n*10 + (c - '0');
+            continue;
+        }
+        if (is_blank(c)) {
+            continue;
+        }
+        int count = n > 0 ? (int)n : 1;
+        n = 0;
+        if (c == '!') {
+            break;
+        }
+        if (c == '$') {
+            x += count;
+            y = 0;
+            continue;
+        }
+        int state;
+        if (c == 'b' || c == '.') {
+            state = 0;
+        } else if (c >= 'A' && c <= 'X') {
+            state = c - 'A' + 1;
+        } else if (c >= 'p' && c <= 'y' && s < end && *s >= 'A' && *s <= 'X') {
+            state = 24 * (c - 'p' + 1) + (*s++ - 'A' + 1);
+        } else {
+            state = 1;
+        }
+        if (state >= p->states) {
+            state = 1;
+        }
+        if (state != 0 && x >= lo) {
+            int *row = dst + (size_t)(x - lo) * stride;
+            int from = y > clo ? y : clo, to = y + count < chi ? y + count : chi;
+            for (int i = from; i < to; i++) {
+                row[i - clo] = state;
+            }
+        }
+        y += count;
+    }
+
+}
+
+
+/*
+ * Interior rows [start, end) of grid from the pattern, plus the ghost rows
+ * next to them, like ca_grid_randomize_rows(): the rows are cleared in both
+ * generations, then the pattern's cells in them are written.
+ */
+void pattern_rows(const pattern_t *p, ca_grid_t *grid, int start, int end) {
+
+    const int mc = grid->max_cols;
+    int first = start <= 1 ? 0 : start;
+    int last = end >= grid->max_rows - 1 ? grid->max_rows : end;
+
+    for (int x = first; x < last; x++) {
+        int *row = grid->cells + (size_t)x*mc;
+        int *next = grid->next + (size_t)x*mc;
+        if (x == 0 || x == grid->max_rows - 1) {
+            for (int y = 0; y < mc; y++) {
+                row[y] = 1;
+                next[y] = 1;
+            }
+            continue;
+        }
+        memset(row, 0, mc * sizeof(int));
+        memset(next, 0, mc * sizeof(int));
+        row[0] = row[mc-1] = 1;
+        next[0] = next[mc-1] = 1;
+    }
+    if (end > start) {
+        pattern_place(p, start, end - start, 1, grid->cols,
+                      grid->cells + (size_t)start*mc + 1, mc);
+    }
+
+}
+
+
+void pattern_close(pattern_t *p) {
+
+    if (p->map != NULL) {
+        munmap(p->map, p->size);
+    }
+    free(p->rows);
+    close(p->fd);
+
+}
@@ -0,0 +1,61 @@
+/*
+ * pattern.h
+ *
+ * Initial cellspace from a pattern file (config.pattern) in one of the two
+ * usual Life formats:
+ *
+ *   RLE        "#" comment lines, a "x = w, y = h, rule = ..." header, then
+ *              run-length encoded rows: b/. dead, o live, A-X (with a p-y
+ *              prefix past X) the states of Generations rules, $ ends a row,
+ *              ! ends the pattern
+ *   plaintext  "!" comment lines, then one line per row: . dead, O or * live
+ *
+ * The rest of the cellspace starts out dead. The pattern goes at
+ * config.pattern_row/pattern_col (interior coordinates of its top left
+ * cell), centered on either axis left at -1, and has to fit in the grid.
+ *
+ * The file is mapped and parsed in place. Opening it indexes where every
+ * row starts, then each thread, or MPI rank, seeks to its own rows and
+ * decodes just those, and just its own columns of them.
+ */
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ca.h"
+#include "rule.h"
+
+/* where the data of a pattern row starts, and the row the parse is on there
+   (further down after a run of empty rows, "3$") */
+typedef struct {
+    const char *data;
+    int row;
+} pattern_row_t;
+
+/* a pattern mapped for reading, placed in a grid */
+typedef struct {
+    int fd;
+    void *map;
+    size_t size;
+    bool rle;
+    const char *data;           /* first row */
+    const char *end;
+    pattern_row_t *rows;        /* one per pattern row */
+    int width;
+    int height;
+    int row;                    /* top left cell in the grid, ghost border counted */
+    int col;
+    int states;                 /* of the engine's rule, higher states become 1 */
+} pattern_t;
+
+int pattern_rule(const char *path, char *rule, size_t len);
+int pattern_open(pattern_t *p, const char *path, const ca_engine_t *engine);
+void pattern_place(const pattern_t *p, int first_row, int rows, int first_col, int cols,
+                   int *dst, int stride);
+void pattern_rows(const pattern_t *p, ca_grid_t *grid, int start, int end);
+void pattern_close(pattern_t *p);
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * pool.c
+ *
+ * Persistent worker pool, see pool.h. The barrier is the sense-reversing
+ * spin barrier from spin_barrier.c, or pthread_barrier_wait with spin off.
+ * Jobs meet at pool_barrier(), which the profile times; handing out a job
+ * and parking between jobs use the same barrier untimed.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+typedef struct {
+    pool_t *pool;
+    int rank;
+} worker_arg_t;
+
+
+static void wait_all(pool_t *pool, int rank) {
+
+    if (pool->spin) {
+        spin_barrier_wait(&pool->spin_barrier, &pool->sense[rank]);
+    } else {
+        int returnVal = pthread_barrier_wait(&pool->barrier);
+        if (returnVal != 0 && returnVal != PTHREAD_BARRIER_SERIAL_THREAD) {
+            printf("ERROR: could not wait on the barrier\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+}
+
+
+void pool_barrier(pool_t *pool, int rank) {
+
+    PROFILE_BEGIN(pool->profile, rank, PROFILE_BARRIER);
+    wait_all(pool, rank);
+    PROFILE_END(pool->profile, rank);
+
+}
+
+
+/* ================== THREAD FUNCTION =============== */
+
+static void *worker(void *arg) {
+
+    pool_t *pool = ((worker_arg_t*) arg)->pool;
+    int rank = ((worker_arg_t*) arg)->rank;
+    free(arg);
+
+    while (1) {
+        // wait for the next pool_run()
+        wait_all(pool, rank);
+        if (pool->job == NULL) {
+            break;
+        }
+        PROFILE_BEGIN(pool->profile, rank, pool->phase);
+        pool->job(pool, rank, pool->arg);
+        PROFILE_END(pool->profile, rank);
+    }
+    return NULL;
+
+}
+
+
+/*
+ * Start threads-1 workers, timed in profile if it isn't NULL. Returns NULL
+ * if the barrier can't be set up.
+ */
+pool_t *pool_create(int threads, bool spin, profile_t *profile) {
+
+    pool_t *pool = (pool_t*) calloc(1, sizeof(pool_t));
+    pool->threads = threads > 0 ? threads : 1;
+    pool->spin = spin;
+    pool->profile = profile;
+    profile_threads(profile, pool->threads);
+    pool->handles = (pthread_t*) malloc(pool->threads * sizeof(pthread_t));
+    pool->sense = (int*) calloc(pool->threads, sizeof(int));
+
+    spin_barrier_init(&pool->spin_barrier, pool->threads);
+    if (pthread_barrier_init(&pool->barrier, NULL, pool->threads) != 0) {
+        printf("ERROR: could not initialize the barrier\n");
+        free(pool->handles);
+        free(pool->sense);
+        free(pool);
+        return NULL;
+    }
+
+    for (int t = 1; t < pool->threads; t++) {
+        worker_arg_t *arg = (worker_arg_t*) malloc(sizeof(worker_arg_t));
+        arg->pool = pool;
+        arg->rank = t;
+        pthread_create(&pool->handles[t], NULL, worker, arg);
+    }
+    return pool;
+
+}
+
+
+/*
+ * Run job on every thread, the calling thread as rank 0.
+ */
+void pool_run(pool_t *pool, pool_job_t job, void *arg) {
+
+    pool->job = job;
+    pool->arg = arg;
+    pool->phase = pool->profile != NULL ? profile_phase(pool->profile, 0) : PROFILE_IDLE;
+    wait_all(pool, 0);
+    job(pool, 0, arg);
+
+}
+
+
+static void pin(pool_t *pool, int rank, void *arg) {
+
+    affinity_pin((affinity_t*) arg, rank);
+    pool_barrier(pool, rank);
+
+}
+
+
+/*
+ * Pin every thread of the pool, rank r as thread r of affinity.
+ */
+void pool_pin(pool_t *pool, affinity_t *affinity) {
+
+    if (affinity->threads > 0) {
+        pool_run(pool, pin, affinity);
+    }
+
+}
+
+
+void pool_free(pool_t *pool) {
+
+    pool->job = NULL;
+    wait_all(pool, 0);
+    for (int t = 1; t < pool->threads; t++) {
+        pthread_join(pool->handles[t], NULL);
+    }
+    if (pthread_barrier_destroy(&pool->barrier) != 0) {
+        printf("ERROR: could not destroy the barrier\n");
+        exit(EXIT_FAILURE);
+    }
+    free(pool->handles);
+    free(pool->sense);
+    free(pool);
+
+}
@@ -0,0 +1,51 @@
+/*
+ * pool.h
+ *
+ * Persistent pool of worker threads for the threaded backends. The pool is
+ * created with the engine and parked between steps; the calling thread
+ * works as rank 0, so threads counts it too.
+ *
+ * pool_run() releases the workers and runs the job on every thread. The job
+ * has to read whatever parameters it needs before its first pool_barrier()
+ * and end with a pool_barrier() after which it no longer touches shared
+ * state: rank 0 returns from pool_run() as soon as its own job returns, and
+ * may post the next job right away.
+ *
+ * With a profile (profile.h), rank r is its thread r: a worker runs each
+ * job in the phase rank 0 posted it from, and time in pool_barrier() counts
+ * as barrier. Waiting for a job between runs is idle.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "spin_barrier.h"
+#include "affinity.h"
+#include "profile.h"
+
+typedef struct pool pool_t;
+typedef void (*pool_job_t)(pool_t *pool, int rank, void *arg);
+
+struct pool {
+    int threads;
+    bool spin;              /* spin barrier instead of pthread_barrier_t */
+    pthread_t *handles;
+    spin_barrier_t spin_barrier;
+    pthread_barrier_t barrier;
+    int *sense;             /* local sense per thread */
+    pool_job_t job;         /* NULL to quit */
+    void *arg;
+    profile_t *profile;     /* may be NULL */
+    int phase;              /* of the current job */
+};
+
+pool_t *pool_create(int threads, bool spin, profile_t *profile);
+void pool_run(pool_t *pool, pool_job_t job, void *arg);
+void pool_barrier(pool_t *pool, int rank);
+void pool_pin(pool_t *pool, affinity_t *affinity);
+void pool_free(pool_t *pool);
+
+#endif
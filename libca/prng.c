@@ -0,0 +1,91 @@
+/*
+ * prng.c
+ *
+ * Seeding and jumps for the xoshiro256** streams and the Philox4x32-10
+ * counter-based generator, see prng.h. Both follow the reference
+ * implementations (Blackman and Vigna; Salmon et al., Random123).
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include "prng.h"
+
+
+static uint64_t splitmix64(uint64_t *x) {
+
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+
+}
+
+
+/*
+ * Seed stream number stream of seed.
+ */
+void prng_seed(prng_t *prng, uint64_t seed, uint64_t stream) {
+
+    uint64_t x = seed;
+    for (int i = 0; i < 4; i++) {
+        prng->s[i] = splitmix64(&x);
+    }
+    for (uint64_t i = 0; i < stream; i++) {
+        prng_jump(prng);
+    }
+
+}
+
+
+/*
+ * Advance by 2^128 draws.
+ */
+void prng_jump(prng_t *prng) {
+
+    static const uint64_t jump[] = {
+        0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+        0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+    };
+    uint64_t s[4] = {0, 0, 0, 0};
+
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (jump[i] & (1ULL << b)) {
+                for (int k = 0; k < 4; k++) {
+                    s[k] ^= prng->s[k];
+                }
+            }
+            prng_next(prng);
+        }
+    }
+    for (int k = 0; k < 4; k++) {
+        prng->s[k] = s[k];
+    }
+
+}
+
+
+/*
+ * 64 random bits for (seed, stream, index): the first half of one
+ * Philox4x32-10 block with counter (index, stream) and key seed.
+ */
+uint64_t prng_hash(uint64_t seed, uint64_t stream, uint64_t index) {
+
+    uint32_t c[4] = {(uint32_t)index, (uint32_t)(index >> 32),
+                     (uint32_t)stream, (uint32_t)(stream >> 32)};
+    uint32_t k[2] = {(uint32_t)seed, (uint32_t)(seed >> 32)};
+
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)0xD2511F53u * c[0];
+        uint64_t p1 = (uint64_t)0xCD9E8D57u * c[2];
+        uint32_t next[4] = {(uint32_t)(p1 >> 32) ^ c[1] ^ k[0], (uint32_t)p1,
+                            (uint32_t)(p0 >> 32) ^ c[3] ^ k[1], (uint32_t)p0};
+        for (int i = 0; i < 4; i++) {
+            c[i] = next[i];
+        }
+        k[0] += 0x9E3779B9u;
+        k[1] += 0xBB67AE85u;
+    }
+    return (uint64_t)c[1] << 32 | c[0];
+
+}
@@ -0,0 +1,76 @@
+/*
+ * prng.h
+ *
+ * Random numbers for libca, all derived from config.seed so that a run is
+ * reproducible regardless of thread or rank count.
+ *
+ *   prng_t       xoshiro256** stream generator: fast sequential draws for
+ *                the asynchronous update orders. prng_seed() expands the
+ *                seed with splitmix64 and jumps 2^128 draws ahead per stream
+ *                number, so streams for different threads never overlap.
+ *   prng_hash()  Philox4x32-10 counter-based generator: the value for
+ *                (seed, stream, index) is computed directly with no state,
+ *                so any thread or rank can produce any cell's number.
+ *
+ * Unlike rand() none of this takes a lock or shares state between threads.
+ */
+
+#ifndef PRNG_H
+#define PRNG_H
+
+#include <stdint.h>
+
+/* prng_hash() streams */
+#define PRNG_STREAM_GRID 0      /* initial cellspace, 64 cells per index */
+#define PRNG_STREAM_IND  1      /* rand_ind_pthreads, one seed per batch of updates */
+#define PRNG_STREAM_DENSITY 2   /* ensemble members at density != 0.5, per cell */
+
+typedef struct {
+    uint64_t s[4];
+} prng_t;
+
+void prng_seed(prng_t *prng, uint64_t seed, uint64_t stream);
+void prng_jump(prng_t *prng);
+uint64_t prng_hash(uint64_t seed, uint64_t stream, uint64_t index);
+
+static inline uint64_t prng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+/*
+ * Next 64 random bits.
+ */
+static inline uint64_t prng_next(prng_t *prng) {
+
+    uint64_t *s = prng->s;
+    uint64_t result = prng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = prng_rotl(s[3], 45);
+    return result;
+
+}
+
+/*
+ * Uniform integer in [0, n), n > 0, without modulo bias (Lemire's
+ * multiply-and-reject).
+ */
+static inline uint32_t prng_below(prng_t *prng, uint32_t n) {
+
+    uint64_t m = (prng_next(prng) >> 32) * n;
+    if ((uint32_t)m < n) {
+        uint32_t threshold = -n % n;
+        while ((uint32_t)m < threshold) {
+            m = (prng_next(prng) >> 32) * n;
+        }
+    }
+    return (uint32_t)(m >> 32);
+
+}
+
+#endif
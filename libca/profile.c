@@ -0,0 +1,170 @@
+/*
+ * profile.c
+ *
+ * Per-thread phase clocks, see profile.h.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+
+static const char *phase_names[PROFILE_PHASES] = {
+    "init", "compute", "barrier", "comm", "output"
+};
+
+
+static double now() {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+
+}
+
+
+static profile_slot_t *alloc_slots(int threads) {
+
+    void *slot = NULL;
+    if (posix_memalign(&slot, 64, threads * sizeof(profile_slot_t)) != 0) {
+        printf("ERROR: could not allocate the profile\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(slot, 0, threads * sizeof(profile_slot_t));
+    for (int t = 0; t < threads; t++) {
+        ((profile_slot_t*) slot)[t].phase = PROFILE_IDLE;
+    }
+    return (profile_slot_t*) slot;
+
+}
+
+
+/*
+ * A profile with a slot for the calling thread only, see profile_threads().
+ */
+profile_t *profile_create() {
+
+    profile_t *p = (profile_t*) malloc(sizeof(profile_t));
+    p->threads = 1;
+    p->slot = alloc_slots(1);
+    return p;
+
+}
+
+
+/*
+ * Make room for threads threads, the new ones idle. Backends call it from
+ * init, before their workers start switching phases.
+ */
+void profile_threads(profile_t *p, int threads) {
+
+    if (p == NULL || threads <= p->threads) {
+        return;
+    }
+    profile_slot_t *slot = alloc_slots(threads);
+    memcpy(slot, p->slot, p->threads * sizeof(profile_slot_t));
+    free(p->slot);
+    p->slot = slot;
+    p->threads = threads;
+
+}
+
+
+/*
+ * Charge the time since thread's last switch to its current phase and enter
+ * phase. Returns the phase it left.
+ */
+int profile_switch(profile_t *p, int thread, int phase) {
+
+    profile_slot_t *s = &p->slot[thread];
+    double t = now();
+    int prev = s->phase;
+    s->total[prev] += t - s->since;
+    s->since = t;
+    s->phase = phase;
+    return prev;
+
+}
+
+
+int profile_phase(const profile_t *p, int thread) {
+
+    return p->slot[thread].phase;
+
+}
+
+
+/*
+ * Copy the totals, threads * PROFILE_PHASES seconds, to totals.
+ */
+void profile_totals(const profile_t *p, double *totals) {
+
+    for (int t = 0; t < p->threads; t++) {
+        memcpy(totals + t * PROFILE_PHASES, p->slot[t].total, PROFILE_PHASES * sizeof(double));
+    }
+
+}
+
+
+/*
+ * Print a table of totals, one row of PROFILE_PHASES seconds per thread (or
+ * rank, after label), then the mean and max over the rows and the
+ * imbalance max / mean - 1 of each phase.
+ */
+void profile_print(const double *totals, int threads, const char *label) {
+
+    double mean[PROFILE_PHASES + 1] = {0}, max[PROFILE_PHASES + 1] = {0};
+
+    printf("profile (s):\n%-10s", label);
+    for (int k = 0; k < PROFILE_PHASES; k++) {
+        printf(" %10s", phase_names[k]);
+    }
+    printf(" %10s\n", "total");
+    for (int t = 0; t < threads; t++) {
+        const double *row = totals + t * PROFILE_PHASES;
+        double sum = 0.0;
+        printf("%-10d", t);
+        for (int k = 0; k <= PROFILE_PHASES; k++) {
+            double v = k < PROFILE_PHASES ? row[k] : sum;
+            sum += k < PROFILE_PHASES ? v : 0.0;
+            printf(" %10.4f", v);
+            mean[k] += v / threads;
+            max[k] = v > max[k] ? v : max[k];
+        }
+        printf("\n");
+    }
+    printf("%-10s", "mean");
+    for (int k = 0; k <= PROFILE_PHASES; k++) {
+        printf(" %10.4f", mean[k]);
+    }
+    printf("\n%-10s", "max");
+    for (int k = 0; k <= PROFILE_PHASES; k++) {
+        printf(" %10.4f", max[k]);
+    }
+    printf("\n%-10s", "imbalance");
+    for (int k = 0; k <= PROFILE_PHASES; k++) {
+        if (mean[k] > 0.0) {
+            printf(" %9.1f%%", 100.0 * (max[k] / mean[k] - 1.0));
+        } else {
+            printf(" %10s", "-");
+        }
+    }
+    printf("\n");
+
+}
+
+
+void profile_free(profile_t *p) {
+
+    if (p == NULL) {
+        return;
+    }
+    free(p->slot);
+    free(p);
+
+}
@@ -0,0 +1,77 @@
+/*
+ * profile.h
+ *
+ * Per-thread phase timing of an engine, built in with make PROFILE=1
+ * (CA_PROFILE). Each thread of the engine, thread 0 being the calling
+ * thread and the others the backend's workers, has a slot holding the time
+ * it spent in each phase:
+ *
+ *   init      ca_engine_create(), the parallel fill included
+ *   compute   stepping, less the two phases below
+ *   barrier   waiting for the other threads (pool_barrier(), OpenMP
+ *             barriers) or, under MPI, for the other ranks
+ *   comm      MPI messages: allgather, halo exchange, gathers in sync
+ *   output    checkpoints, snapshots and queuing frames
+ *
+ * A thread is in one phase at a time, idle (not reported) outside libca.
+ * profile_switch() charges the time since the last switch, read from
+ * CLOCK_MONOTONIC, to the phase the thread leaves, and only ever touches the
+ * slot of the thread calling it, so the slots need no locking.
+ *
+ * Built without CA_PROFILE, engine->profile is NULL and the PROFILE_*
+ * macros compile to nothing. ca_engine_profile() prints the table.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+enum {
+    PROFILE_INIT,
+    PROFILE_COMPUTE,
+    PROFILE_BARRIER,
+    PROFILE_COMM,
+    PROFILE_OUTPUT,
+    PROFILE_PHASES,
+    PROFILE_IDLE = PROFILE_PHASES
+};
+
+/* one thread's clock, a cache line of its own so threads don't share one */
+typedef struct {
+    double total[PROFILE_PHASES + 1];   /* seconds per phase, idle last */
+    double since;                       /* time of the last switch */
+    int phase;
+    char pad[64 - ((PROFILE_PHASES + 2) * sizeof(double) + sizeof(int)) % 64];
+} profile_slot_t;
+
+typedef struct {
+    int threads;
+    profile_slot_t *slot;
+} profile_t;
+
+profile_t *profile_create();
+void profile_threads(profile_t *p, int threads);
+int profile_switch(profile_t *p, int thread, int phase);
+int profile_phase(const profile_t *p, int thread);
+void profile_totals(const profile_t *p, double *totals);
+void profile_print(const double *totals, int threads, const char *label);
+void profile_free(profile_t *p);
+
+/*
+ * PROFILE_BEGIN puts thread in phase until the matching PROFILE_END of the
+ * same block, which returns it to the phase it was in; PROFILE_SWITCH moves
+ * to another phase in between. One PROFILE_BEGIN per block.
+ */
+#ifdef CA_PROFILE
+#define PROFILE_BEGIN(p, thread, phase) \
+    int _profile_prev = (p) != NULL ? profile_switch((p), (thread), (phase)) : PROFILE_IDLE
+#define PROFILE_SWITCH(p, thread, phase) \
+    do { if ((p) != NULL) profile_switch((p), (thread), (phase)); } while (0)
+#define PROFILE_END(p, thread) \
+    do { if ((p) != NULL) profile_switch((p), (thread), _profile_prev); } while (0)
+#else
+#define PROFILE_BEGIN(p, thread, phase) do { } while (0)
+#define PROFILE_SWITCH(p, thread, phase) do { } while (0)
+#define PROFILE_END(p, thread) do { } while (0)
+#endif
+
+#endif
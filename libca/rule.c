@@ -0,0 +1,209 @@
+/*
+ * rule.c
+ *
+ * Rule strings, specialized Life-like row kernels and the table-driven
+ * fallback. See rule.h.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "rule.h"
+
+/* bit masks of neighbor counts */
+#define N0 0x001
+#define N1 0x002
+#define N2 0x004
+#define N3 0x008
+#define N4 0x010
+#define N5 0x020
+#define N6 0x040
+#define N7 0x080
+#define N8 0x100
+
+/* Life-like rules with a specialized kernel: X(kernel, birth, survive) */
+#define SPECIALIZED_RULES(X) \
+    X(row_highlife,   N3|N6,             N2|N3)                       /* B36/S23 */ \
+    X(row_day_night,  N3|N6|N7|N8,       N3|N4|N6|N7|N8)              /* B3678/S34678 */ \
+    X(row_seeds,      N2,                0)                           /* B2/S */ \
+    X(row_no_death,   N3,                N0|N1|N2|N3|N4|N5|N6|N7|N8)  /* B3/S012345678 */ \
+    X(row_maze,       N3,                N1|N2|N3|N4|N5)              /* B3/S12345 */ \
+    X(row_2x2,        N3|N6,             N1|N2|N5)                    /* B36/S125 */ \
+    X(row_morley,     N3|N6|N8,          N2|N4|N5)                    /* B368/S245 */ \
+    X(row_replicator, N1|N3|N5|N7,       N1|N3|N5|N7)                 /* B1357/S1357 */ \
+    X(row_diamoeba,   N3|N5|N6|N7|N8,    N5|N6|N7|N8)                 /* B35678/S5678 */
+
+
+/*
+ * Row kernel for a Life-like rule with birth mask B and survival mask S
+ * known at compile time.
+ */
+#define DEFINE_RULE_KERNEL(fn, B, S) \
+static void fn(const int *up, const int *mid, const int *down, int *out, int cols) { \
+    for (int j = 1; j < cols-1; j++) { \
+        int n = up[j-1] + up[j] + up[j+1] \
+              + mid[j-1] + mid[j+1] \
+              + down[j-1] + down[j] + down[j+1]; \
+        unsigned mask = mid[j] ? (S) : (B); \
+        out[j] = (mask >> n) & 1; \
+    } \
+}
+
+SPECIALIZED_RULES(DEFINE_RULE_KERNEL)
+
+#define RULE_ENTRY(fn, B, S) { (B), (S), fn },
+
+static const struct {
+    unsigned birth;
+    unsigned survive;
+    row_kernel_t row;
+} specialized[] = {
+    SPECIALIZED_RULES(RULE_ENTRY)
+};
+
+
+/*
+ * Parse a list of neighbor counts ("236") into a mask. Returns the first
+ * character after it.
+ */
+static const char *parse_counts(const char *p, unsigned *mask) {
+
+    *mask = 0;
+    while (*p >= '0' && *p <= '8') {
+        *mask |= 1u << (*p - '0');
+        p++;
+    }
+    return p;
+
+}
+
+
+static void append_counts(char *buf, size_t len, unsigned mask) {
+
+    size_t n = strlen(buf);
+    for (int c = 0; c <= 8 && n + 1 < len; c++) {
+        if (mask & (1u << c)) {
+            buf[n++] = (char)('0' + c);
+        }
+    }
+    buf[n] = '\0';
+
+}
+
+
+/*
+ * Parse "B<counts>/S<counts>" with an optional "/<states>" (or "/C<states>")
+ * for Generations rules. Returns 0 on success.
+ */
+int rule_parse(ca_rule_t *rule, const char *text) {
+
+    memset(rule, 0, sizeof(ca_rule_t));
+    rule->states = 2;
+
+    const char *p = text;
+    if (toupper((unsigned char)*p) != 'B') {
+        return -1;
+    }
+    p = parse_counts(p + 1, &rule->birth);
+    if (*p != '/' || toupper((unsigned char)p[1]) != 'S') {
+        return -1;
+    }
+    p = parse_counts(p + 2, &rule->survive);
+    if (*p == '/') {
+        p++;
+        if (toupper((unsigned char)*p) == 'C') {
+            p++;
+        }
+        char *end;
+        long states = strtol(p, &end, 10);
+        if (end == p || states < 2 || states > RULE_MAX_STATES) {
+            return -1;
+        }
+        rule->states = (int)states;
+        p = end;
+    }
+    if (*p != '\0') {
+        return -1;
+    }
+
+    // canonical name, counts in ascending order
+    strcpy(rule->name, "B");
+    append_counts(rule->name, sizeof(rule->name), rule->birth);
+    strcat(rule->name, "/S");
+    append_counts(rule->name, sizeof(rule->name), rule->survive);
+    if (rule->states > 2) {
+        snprintf(rule->name + strlen(rule->name), sizeof(rule->name) - strlen(rule->name),
+                 "/%d", rule->states);
+    }
+
+    for (int s = 0; s < rule->states; s++) {
+        for (int n = 0; n <= 8; n++) {
+            int next;
+            if (s == 0) {
+                next = (rule->birth >> n) & 1;
+            } else if (s == 1) {
+                next = ((rule->survive >> n) & 1) ? 1 : (rule->states > 2 ? 2 : 0);
+            } else {
+                next = (s + 1 < rule->states) ? s + 1 : 0;
+            }
+            rule->next[s][n] = (unsigned char)next;
+        }
+    }
+
+    if (rule->states == 2) {
+        for (size_t i = 0; i < sizeof(specialized) / sizeof(specialized[0]); i++) {
+            if (specialized[i].birth == rule->birth && specialized[i].survive == rule->survive) {
+                rule->row = specialized[i].row;
+            }
+        }
+    }
+    return 0;
+
+}
+
+
+/*
+ * True for B3/S23, which the built-in kernels implement directly.
+ */
+bool rule_is_life(const ca_rule_t *rule) {
+
+    return rule->states == 2 && rule->birth == N3 && rule->survive == (N2|N3);
+
+}
+
+
+/*
+ * Table-driven row kernel for any rule: columns [1, cols-2].
+ */
+void rule_row(const ca_rule_t *rule, const int *up, const int *mid,
+              const int *down, int *out, int cols) {
+
+    for (int j = 1; j < cols-1; j++) {
+        int n = (up[j-1] == 1) + (up[j] == 1) + (up[j+1] == 1)
+              + (mid[j-1] == 1) + (mid[j+1] == 1)
+              + (down[j-1] == 1) + (down[j] == 1) + (down[j+1] == 1);
+        out[j] = rule->next[mid[j]][n];
+    }
+
+}
+
+
+/*
+ * Next state of cell (x,y) of matrix p under rule.
+ */
+int rule_transition(const ca_rule_t *rule, const int *p, int stride, int x, int y) {
+
+    const int *up = p + (x-1)*stride;
+    const int *mid = p + x*stride;
+    const int *down = p + (x+1)*stride;
+
+    int n = (up[y-1] == 1) + (up[y] == 1) + (up[y+1] == 1)
+          + (mid[y-1] == 1) + (mid[y+1] == 1)
+          + (down[y-1] == 1) + (down[y] == 1) + (down[y+1] == 1);
+    return rule->next[mid[y]][n];
+
+}
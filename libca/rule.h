@@ -0,0 +1,42 @@
+/*
+ * rule.h
+ *
+ * Birth/survival rules. A rule string selects the transition:
+ *
+ *   B3/S23     Life-like: a dead cell is born with a neighbor count in B,
+ *              a live cell survives with a count in S (Game of Life)
+ *   B2/S/3     Generations: as above, but a live cell that doesn't survive
+ *              goes through dying states 2 .. C-1 before it is dead again,
+ *              here with C = 3 states. Only state 1 counts as a neighbor.
+ *
+ * The common Life-like rules have row kernels specialized at compile time
+ * (the B/S masks are constants in each instantiation). Every other rule
+ * runs on a table indexed by [state][live neighbors].
+ */
+
+#ifndef RULE_H
+#define RULE_H
+
+#include <stdbool.h>
+
+#include "simd_kernel.h"
+
+#define RULE_MAX_STATES 256
+#define RULE_NAME_LEN 48
+
+typedef struct {
+    char name[RULE_NAME_LEN];   /* canonical rule string */
+    unsigned birth;             /* bit n: born with n live neighbors */
+    unsigned survive;           /* bit n: survives with n live neighbors */
+    int states;                 /* 2 for Life-like rules */
+    row_kernel_t row;           /* specialized row kernel, NULL if none */
+    unsigned char next[RULE_MAX_STATES][9];  /* next state by [state][neighbors] */
+} ca_rule_t;
+
+int rule_parse(ca_rule_t *rule, const char *text);
+bool rule_is_life(const ca_rule_t *rule);
+void rule_row(const ca_rule_t *rule, const int *up, const int *mid,
+              const int *down, int *out, int cols);
+int rule_transition(const ca_rule_t *rule, const int *p, int stride, int x, int y);
+
+#endif
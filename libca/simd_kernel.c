@@ -0,0 +1,184 @@
+/*
+ * simd_kernel.c
+ *
+ * SSE2/AVX2/AVX-512 row kernels for the Game of Life step, compiled with
+ * per-function target attributes and chosen with __builtin_cpu_supports().
+ * See simd_kernel.h.
+ *
+ * Each kernel adds the eight neighbor vectors (unaligned loads at column
+ * offsets -1, 0, +1 of the three rows) and applies B3/S23 with compares:
+ *   next = (n == 3) | (alive & (n == 2))
+ * The columns left over after the last full vector fall back to the scalar
+ * kernel.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <string.h>
+
+#include "simd_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+
+/*
+ * Scalar reference kernel for columns [start, cols-2].
+ */
+static void row_scalar_from(const int *up, const int *mid, const int *down,
+                            int *out, int start, int cols) {
+
+    for (int j = start; j < cols-1; j++) {
+        int n = up[j-1] + up[j] + up[j+1]
+              + mid[j-1] + mid[j+1]
+              + down[j-1] + down[j] + down[j+1];
+        out[j] = (n == 3) | (mid[j] & (n == 2));
+    }
+
+}
+
+
+static void row_scalar(const int *up, const int *mid, const int *down,
+                       int *out, int cols) {
+
+    row_scalar_from(up, mid, down, out, 1, cols);
+
+}
+
+
+#ifdef HAVE_X86_SIMD
+
+__attribute__((target("sse2")))
+static void row_sse2(const int *up, const int *mid, const int *down,
+                     int *out, int cols) {
+
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    const __m128i three = _mm_set1_epi32(3);
+    int j = 1;
+
+    for (; j + 4 <= cols-1; j += 4) {
+        __m128i n = _mm_add_epi32(
+            _mm_add_epi32(_mm_loadu_si128((const __m128i*)(up + j-1)),
+                          _mm_loadu_si128((const __m128i*)(up + j))),
+            _mm_loadu_si128((const __m128i*)(up + j+1)));
+        n = _mm_add_epi32(n, _mm_loadu_si128((const __m128i*)(mid + j-1)));
+        n = _mm_add_epi32(n, _mm_loadu_si128((const __m128i*)(mid + j+1)));
+        n = _mm_add_epi32(n, _mm_loadu_si128((const __m128i*)(down + j-1)));
+        n = _mm_add_epi32(n, _mm_loadu_si128((const __m128i*)(down + j)));
+        n = _mm_add_epi32(n, _mm_loadu_si128((const __m128i*)(down + j+1)));
+
+        __m128i alive = _mm_loadu_si128((const __m128i*)(mid + j));
+        __m128i born = _mm_cmpeq_epi32(n, three);
+        __m128i stay = _mm_and_si128(_mm_cmpeq_epi32(n, two),
+                                     _mm_cmpeq_epi32(alive, one));
+        _mm_storeu_si128((__m128i*)(out + j),
+                         _mm_and_si128(_mm_or_si128(born, stay), one));
+    }
+    row_scalar_from(up, mid, down, out, j, cols);
+
+}
+
+
+__attribute__((target("avx2")))
+static void row_avx2(const int *up, const int *mid, const int *down,
+                     int *out, int cols) {
+
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i three = _mm256_set1_epi32(3);
+    int j = 1;
+
+    for (; j + 8 <= cols-1; j += 8) {
+        __m256i n = _mm256_add_epi32(
+            _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(up + j-1)),
+                             _mm256_loadu_si256((const __m256i*)(up + j))),
+            _mm256_loadu_si256((const __m256i*)(up + j+1)));
+        n = _mm256_add_epi32(n, _mm256_loadu_si256((const __m256i*)(mid + j-1)));
+        n = _mm256_add_epi32(n, _mm256_loadu_si256((const __m256i*)(mid + j+1)));
+        n = _mm256_add_epi32(n, _mm256_loadu_si256((const __m256i*)(down + j-1)));
+        n = _mm256_add_epi32(n, _mm256_loadu_si256((const __m256i*)(down + j)));
+        n = _mm256_add_epi32(n, _mm256_loadu_si256((const __m256i*)(down + j+1)));
+
+        __m256i alive = _mm256_loadu_si256((const __m256i*)(mid + j));
+        __m256i born = _mm256_cmpeq_epi32(n, three);
+        __m256i stay = _mm256_and_si256(_mm256_cmpeq_epi32(n, two),
+                                        _mm256_cmpeq_epi32(alive, one));
+        _mm256_storeu_si256((__m256i*)(out + j),
+                            _mm256_and_si256(_mm256_or_si256(born, stay), one));
+    }
+    row_scalar_from(up, mid, down, out, j, cols);
+
+}
+
+
+__attribute__((target("avx512f")))
+static void row_avx512(const int *up, const int *mid, const int *down,
+                       int *out, int cols) {
+
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i two = _mm512_set1_epi32(2);
+    const __m512i three = _mm512_set1_epi32(3);
+    int j = 1;
+
+    for (; j + 16 <= cols-1; j += 16) {
+        __m512i n = _mm512_add_epi32(
+            _mm512_add_epi32(_mm512_loadu_si512(up + j-1),
+                             _mm512_loadu_si512(up + j)),
+            _mm512_loadu_si512(up + j+1));
+        n = _mm512_add_epi32(n, _mm512_loadu_si512(mid + j-1));
+        n = _mm512_add_epi32(n, _mm512_loadu_si512(mid + j+1));
+        n = _mm512_add_epi32(n, _mm512_loadu_si512(down + j-1));
+        n = _mm512_add_epi32(n, _mm512_loadu_si512(down + j));
+        n = _mm512_add_epi32(n, _mm512_loadu_si512(down + j+1));
+
+        __m512i alive = _mm512_loadu_si512(mid + j);
+        __mmask16 born = _mm512_cmpeq_epi32_mask(n, three);
+        __mmask16 stay = _mm512_cmpeq_epi32_mask(n, two)
+                       & _mm512_cmpeq_epi32_mask(alive, one);
+        _mm512_storeu_si512(out + j, _mm512_maskz_mov_epi32(born | stay, one));
+    }
+    row_scalar_from(up, mid, down, out, j, cols);
+
+}
+
+#endif
+
+
+row_kernel_t simd_select(const char *name, const char **selected) {
+
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    int avx512 = __builtin_cpu_supports("avx512f");
+    int avx2 = __builtin_cpu_supports("avx2");
+    int sse2 = __builtin_cpu_supports("sse2");
+
+    if (strcmp(name, "simd") == 0) {
+        name = avx512 ? "avx512" : avx2 ? "avx2" : sse2 ? "sse2" : "scalar";
+    }
+    if (strcmp(name, "avx512") == 0 && avx512) {
+        *selected = "avx512";
+        return row_avx512;
+    }
+    if (strcmp(name, "avx2") == 0 && avx2) {
+        *selected = "avx2";
+        return row_avx2;
+    }
+    if (strcmp(name, "sse2") == 0 && sse2) {
+        *selected = "sse2";
+        return row_sse2;
+    }
+#else
+    if (strcmp(name, "simd") == 0) {
+        name = "scalar";
+    }
+#endif
+    if (strcmp(name, "scalar") == 0) {
+        *selected = "scalar";
+        return row_scalar;
+    }
+    return NULL;
+
+}
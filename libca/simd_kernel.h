@@ -0,0 +1,27 @@
+/*
+ * simd_kernel.h
+ *
+ * Vectorized row kernels for the int cellspace. A row kernel computes the
+ * next state of columns [1, cols-2] of one row from the rows above, at and
+ * below it, so a whole row segment is handled per call instead of one
+ * transition() per cell.
+ *
+ * The widest instruction set supported by the running CPU is picked at
+ * startup (AVX-512, then AVX2, then SSE2), so one binary runs on every node.
+ */
+
+#ifndef SIMD_KERNEL_H
+#define SIMD_KERNEL_H
+
+typedef void (*row_kernel_t)(const int *up, const int *mid, const int *down,
+                             int *out, int cols);
+
+/*
+ * Look up a row kernel by name: "simd" selects the best one for this CPU,
+ * "avx512", "avx2", "sse2" and "scalar" force a specific one. Returns NULL
+ * if the name is unknown or the CPU does not support it. The name of the
+ * kernel actually chosen is stored in *selected.
+ */
+row_kernel_t simd_select(const char *name, const char **selected);
+
+#endif
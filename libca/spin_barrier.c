@@ -0,0 +1,106 @@
+/*
+ * spin_barrier.c
+ *
+ * Sense-reversing spin barrier with a futex fallback. See spin_barrier.h.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#define _GNU_SOURCE
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "spin_barrier.h"
+
+
+static inline void cpu_relax() {
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+
+}
+
+
+/*
+ * Sleep while *addr still holds val.
+ */
+static void futex_wait(int *addr, int val) {
+
+#ifdef __linux__
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+    (void)addr;
+    (void)val;
+    sched_yield();
+#endif
+
+}
+
+
+/*
+ * Wake every thread sleeping on addr.
+ */
+static void futex_wake(int *addr) {
+
+#ifdef __linux__
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+    (void)addr;
+#endif
+
+}
+
+
+void spin_barrier_init(spin_barrier_t *b, int count) {
+
+    b->count = count;
+    b->remaining = count;
+    b->sense = 0;
+    b->sleepers = 0;
+    b->spins = (count > sysconf(_SC_NPROCESSORS_ONLN)) ? 0 : SPIN_BARRIER_SPINS;
+
+}
+
+
+/*
+ * The last thread to arrive resets the count for the next round before it
+ * flips the sense, so nobody can enter the next round early. A sleeper
+ * registers itself before re-checking the sense inside futex_wait, and the
+ * last arrival flips the sense before checking for sleepers, so a wakeup
+ * can't be lost between the two.
+ */
+void spin_barrier_wait(spin_barrier_t *b, int *local_sense) {
+
+    int my_sense = !*local_sense;
+    *local_sense = my_sense;
+
+    if (__atomic_sub_fetch(&b->remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+        __atomic_store_n(&b->remaining, b->count, __ATOMIC_RELAXED);
+        __atomic_store_n(&b->sense, my_sense, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&b->sleepers, __ATOMIC_SEQ_CST) > 0) {
+            futex_wake(&b->sense);
+        }
+        return;
+    }
+
+    for (int i = 0; i < b->spins; i++) {
+        if (__atomic_load_n(&b->sense, __ATOMIC_ACQUIRE) == my_sense) {
+            return;
+        }
+        cpu_relax();
+    }
+
+    __atomic_add_fetch(&b->sleepers, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&b->sense, __ATOMIC_ACQUIRE) != my_sense) {
+        futex_wait(&b->sense, !my_sense);
+    }
+    __atomic_sub_fetch(&b->sleepers, 1, __ATOMIC_SEQ_CST);
+
+}
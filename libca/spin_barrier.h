@@ -0,0 +1,35 @@
+/*
+ * spin_barrier.h
+ *
+ * Sense-reversing barrier for the worker threads. Waiting threads spin on
+ * the shared sense flag for a bounded number of iterations, which is much
+ * cheaper than pthread_barrier_wait when every thread arrives at about the
+ * same time, and then fall back to sleeping on a futex so an oversubscribed
+ * or unbalanced run doesn't burn cores.
+ *
+ * Each thread keeps its own local sense (initialized to 0) and passes it to
+ * every wait. When there are more threads than online CPUs spinning only
+ * steals time from the threads still working, so the barrier sleeps right
+ * away.
+ */
+
+#ifndef SPIN_BARRIER_H
+#define SPIN_BARRIER_H
+
+/*iterations to spin before sleeping on the futex*/
+#ifndef SPIN_BARRIER_SPINS
+#define SPIN_BARRIER_SPINS 20000
+#endif
+
+typedef struct {
+    int count;          /* threads taking part */
+    int remaining;      /* threads still to arrive in this round */
+    int sense;          /* flipped by the last arrival, also the futex word */
+    int sleepers;       /* threads blocked in the futex */
+    int spins;          /* spin budget before sleeping */
+} spin_barrier_t;
+
+void spin_barrier_init(spin_barrier_t *b, int count);
+void spin_barrier_wait(spin_barrier_t *b, int *local_sense);
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * tiles.c
+ *
+ * Activity tracking: only recompute tiles that changed or border a tile
+ * that changed in the last generation. See tiles.h.
+ *
+ * Authors: Paul Bailey, Jenna Horrall, Callan Hand
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ca_internal.h"
+#include "tiles.h"
+
+
+/*
+ * Tiles of size x size cells over a rows x cols interior. Every tile starts
+ * out changed, so the first generation computes the whole grid.
+ */
+void tiles_init(tiles_t *t, int rows, int cols, int size) {
+
+    t->size = size;
+    t->tile_rows = (rows + size - 1) / size;
+    t->tile_cols = (cols + size - 1) / size;
+    size_t n = (size_t)t->tile_rows * t->tile_cols;
+    for (int p = 0; p < 2; p++) {
+        t->changed[p] = (unsigned char*) ca_alloc(n > 0 ? n : 1);
+        memset(t->changed[p], 1, n);
+    }
+    t->parity = 0;
+
+}
+
+
+void tiles_free(tiles_t *t) {
+
+    free(t->changed[0]);
+    free(t->changed[1]);
+
+}
+
+
+/*
+ * Returns true if tile (tr,tc) or one of its neighbors changed.
+ */
+static bool tile_active(const tiles_t *t, const unsigned char *changed,
+                        int tr, int tc) {
+
+    int r0 = tr > 0 ? tr-1 : 0;
+    int r1 = tr < t->tile_rows-1 ? tr+1 : tr;
+    int c0 = tc > 0 ? tc-1 : 0;
+    int c1 = tc < t->tile_cols-1 ? tc+1 : tc;
+
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            if (changed[r*t->tile_cols + c]) {
+                return true;
+            }
+        }
+    }
+    return false;
+
+}
+
+
+/*
+ * Compute tile rows [tile_start, tile_end) of the next generation from src
+ * into dst. Reads the flags of the last generation from changed[parity]
+ * and writes this generation's to changed[parity^1]. Returns the number
+ * of tiles skipped.
+ */
+long tiles_step_rows(const ca_engine_t *engine, tiles_t *t, int parity,
+                     const int *src, int *dst, int tile_start, int tile_end) {
+
+    const ca_grid_t *grid = engine->grid;
+    const int mc = grid->max_cols;
+    const unsigned char *changed = t->changed[parity];
+    unsigned char *next = t->changed[parity^1];
+    long skipped = 0;
+
+    for (int tr = tile_start; tr < tile_end; tr++) {
+        int r0 = 1 + tr*t->size;
+        int r1 = r0 + t->size < grid->rows+1 ? r0 + t->size : grid->rows+1;
+
+        for (int tc = 0; tc < t->tile_cols; tc++) {
+            if (!tile_active(t, changed, tr, tc)) {
+                next[tr*t->tile_cols + tc] = 0;
+                skipped++;
+                continue;
+            }
+
+            int c0 = 1 + tc*t->size;
+            int c1 = c0 + t->size < grid->cols+1 ? c0 + t->size : grid->cols+1;
+            bool diff = false;
+
+            for (int i = r0; i < r1; i++) {
+                if (ca_has_rows(engine)) {
+                    // row kernels update columns [1, cols-2] of their arguments
+                    ca_sweep_row(engine, src + (i-1)*mc + c0-1, src + i*mc + c0-1,
+                                 src + (i+1)*mc + c0-1, dst + i*mc + c0-1,
+                                 c1 - c0 + 2);
+                } else {
+                    for (int j = c0; j < c1; j++) {
+                        *(dst + i*mc + j) = engine->transition(&engine->rule, src, mc, i, j);
+                    }
+                }
+                if (!diff && memcmp(dst + i*mc + c0, src + i*mc + c0,
+                                    (size_t)(c1 - c0) * sizeof(int)) != 0) {
+                    diff = true;
+                }
+            }
+            next[tr*t->tile_cols + tc] = diff;
+        }
+    }
+    return skipped;
+
+}
+
+
+/*
+ * Timing line suffix: tile size and the average share of tiles skipped
+ * per timestep.
+ */
+void tiles_describe(const tiles_t *t, long long skipped, long long total,
+                    char *buf, size_t len) {
+
+    snprintf(buf, len, ", tiles: %dx%d, skipped: %.1f%%", t->size, t->size,
+             total > 0 ? 100.0 * skipped / total : 0.0);
+
+}
@@ -0,0 +1,37 @@
+/*
+ * tiles.h
+ *
+ * Activity tracking for the int cellspace. The interior is divided into
+ * square tiles and a flag per tile records whether any of its cells changed
+ * in the last generation. A tile can only change in the next generation if
+ * it or one of its eight neighboring tiles just changed, so every other tile
+ * is skipped.
+ *
+ * Skipping needs no copy: the synchronous backends swap between two
+ * buffers, and a tile that didn't change last generation already holds the
+ * same cells in both, so the stale copy in dst is the right result.
+ */
+
+#ifndef TILES_H
+#define TILES_H
+
+#include <stdbool.h>
+
+#include "ca.h"
+
+typedef struct {
+    int size;                   /* tile edge in cells */
+    int tile_rows;
+    int tile_cols;
+    unsigned char *changed[2];  /* per tile flags, indexed by generation parity */
+    int parity;                 /* changed[parity] describes the last generation */
+} tiles_t;
+
+void tiles_init(tiles_t *t, int rows, int cols, int size);
+void tiles_free(tiles_t *t);
+long tiles_step_rows(const ca_engine_t *engine, tiles_t *t, int parity,
+                     const int *src, int *dst, int tile_start, int tile_end);
+void tiles_describe(const tiles_t *t, long long skipped, long long total,
+                    char *buf, size_t len);
+
+#endif
@@ -0,0 +1,65 @@
+#!/bin/bash
+#
+# Compare where rand_ind changes cells in a short run, serial and with
+# threads: the changed cells per band of rows (and per even/odd strip of 8
+# rows) should match up to noise. A threaded run that deals its updates out
+# in a fixed strip order shows up as empty bands at the bottom of the grid.
+#
+# usage: ./check_rand_ind_uniformity.sh [rows cols timesteps threads seed]
+
+
+ROWS=${1:-200}
+COLS=${2:-200}
+TIMESTEPS=${3:-2000}
+THREADS=${4:-2}
+SEED=${5:-1}
+BANDS=8
+
+cd ../ca_random
+make > /dev/null || exit 1
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+
+# changed cells per band of rows, then in even and odd strips, of the first
+# and last frame of a .pgm written with --frames-every TIMESTEPS
+changes() {
+   # each frame: P5, "# timestep t", "cols rows", 255, then one byte per cell
+   local size=$(( ROWS * COLS ))
+   local first=$(head -4 "$1" | wc -c)
+   local second=$(tail -c +$(( first + size + 1 )) "$1" | head -4 | wc -c)
+   cmp -l <(tail -c +$(( first + 1 )) "$1" | head -c $size) \
+          <(tail -c +$(( first + size + second + 1 )) "$1" | head -c $size) |
+   awk -v cols=$COLS -v rows=$ROWS -v bands=$BANDS '
+      { r = int(($1 - 1) / cols); band[int(r * bands / rows)]++; strip[int(r / 8) % 2]++ }
+      END {
+         for (b = 0; b < bands; b++) printf "%d ", band[b];
+         printf "%d %d\n", strip[0], strip[1]
+      }'
+}
+
+./rand_ind --seed $SEED --frames "$TMP/serial.pgm" --frames-every $TIMESTEPS \
+   $ROWS $COLS $TIMESTEPS > /dev/null || exit 1
+./rand_ind --seed $SEED --frames "$TMP/threads.pgm" --frames-every $TIMESTEPS -n $THREADS \
+   $ROWS $COLS $TIMESTEPS > /dev/null || exit 1
+
+SERIAL=($(changes "$TMP/serial.pgm"))
+THREADED=($(changes "$TMP/threads.pgm"))
+
+# the counts are roughly Poisson: allow four standard deviations of the
+# difference, plus a few cells for the small ones
+status=0
+for (( i = 0; i < BANDS + 2; i++ ))
+do
+   if (( i < BANDS )); then
+      name="rows $(( i * ROWS / BANDS ))-$(( (i + 1) * ROWS / BANDS - 1 ))"
+   else
+      name=$([ $i -eq $BANDS ] && echo "even strips" || echo "odd strips")
+   fi
+   a=${SERIAL[$i]}
+   b=${THREADED[$i]}
+   ok=$(awk -v a=$a -v b=$b 'BEGIN { d = a - b; if (d * d <= 16 * (a + b) + 25) print "ok"; else print "FAIL" }')
+   printf "%-14s serial %6d  threads %6d  %s\n" "$name" $a $b $ok
+   [ "$ok" = ok ] || status=1
+done
+exit $status